@@ -43,4 +43,6 @@
 #include "imgproc_aux.hpp"
 #include "image_fetcher.hpp"
 #include "integral.hpp"
-#include "pyramid.hpp"
\ No newline at end of file
+#include "pyramid.hpp"
+#include "simd_aux.hpp"
+#include "image_pool.hpp"
\ No newline at end of file
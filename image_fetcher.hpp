@@ -49,8 +49,42 @@
 using namespace boost::filesystem;
 #endif
 
+#if defined(_WIN32) || defined(_WIN64)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>	// for memory mapped files
+#else
+#include <sys/mman.h>	// for memory mapped files
+#include <sys/stat.h>	// also for the directory of the cached listings
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <fstream>
+#include <cctype>
+#include <sstream>
+#include <iomanip>
+#include <iterator>
+#include <cstdio>
+#include <ctime>
+#include <algorithm>
+#include <limits>
+
+#ifdef USE_CXX11
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#endif
+
+/// The default size of 16-bit raw frames, used when the frames have no header
+#ifndef RAW_16BIT_WIDTH
 #define RAW_16BIT_WIDTH		320
+#endif
+#ifndef RAW_16BIT_HEIGHT
 #define RAW_16BIT_HEIGHT	240
+#endif
 
 //!	An auxiliary interface functions for armadillo library.
 namespace auxiliary
@@ -101,43 +135,851 @@ namespace auxiliary
         return '/';
 #endif
     }
-	//!	An implementation of image fetcher.
-	class image_fetcher
+	/**
+	 *	@brief	A read-only memory mapped file.
+	 */
+	class mapped_file
 	{
 	public:
-		//!	Open file or directory
-		void open(const std::string& path)
+		/// Constructor
+		mapped_file(): data_(NULL), size_(0) {}
+
+		/// Destructor
+		~mapped_file() { close(); }
+
+		/**
+		 *	@brief	Maps a file.
+		 *	@return	@c false if the file cannot be opened or is empty
+		 */
+		bool open(const std::string& path)
 		{
-#if defined(USE_BOOST) && defined(USE_OPENCV)
-			boost::filesystem::path p(path);
-			if (boost::filesystem::is_directory(p)) {
-				dir_ = boost::filesystem::absolute(p).string();
-#ifdef USE_CXX11
-				std::for_each(boost::filesystem::directory_iterator(p), 
-					boost::filesystem::directory_iterator(), 
-					[&](boost::filesystem::directory_entry& entry) {
+			close();
+#if defined(_WIN32) || defined(_WIN64)
+			HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+			if (file == INVALID_HANDLE_VALUE) return false;
+
+			LARGE_INTEGER size;
+			HANDLE mapping = NULL;
+			if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+				mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			CloseHandle(file);
+			if (mapping == NULL) return false;
+
+			void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+			if (data == NULL) return false;
+
+			data_ = (unsigned char*)data;
+			size_ = (size_t)size.QuadPart;
 #else
-				boost::filesystem::directory_iterator end;
-				for (boost::filesystem::directory_iterator iter(p) ; iter != end ; ++iter) {
-					boost::filesystem::directory_entry& entry = *iter;
+			const int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) return false;
+
+			struct stat st;
+			void* data = MAP_FAILED;
+			if (fstat(fd, &st) == 0 && st.st_size > 0)
+				data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (data == MAP_FAILED) return false;
+
+			data_ = (unsigned char*)data;
+			size_ = (size_t)st.st_size;
+
+			// the file is mostly read from the beginning to the end
+			madvise(data_, size_, MADV_SEQUENTIAL);
 #endif
+			return true;
+		}
 
-#ifdef USE_16BIT_IMAGE
-					if (boost::filesystem::is_regular_file(entry.status())) // match the extension
+		/// Unmaps the file.
+		void close()
+		{
+			if (data_) {
+#if defined(_WIN32) || defined(_WIN64)
+				UnmapViewOfFile(data_);
 #else
-					if (boost::filesystem::is_regular_file(entry.status()) && 
-						supported_file_formats.find(entry.path().extension().string()) != std::string::npos) // match the extension
+				munmap(data_, size_);
 #endif
-						files_.push_back(entry.path().string());
-#ifdef USE_CXX11
-				});
+			}
+			data_ = NULL;
+			size_ = 0;
+		}
+
+		/// Hints that the bytes [offset, offset + length) will be read soon, so that they are read ahead.
+		void will_need(size_t offset, size_t length) const
+		{
+#if !defined(_WIN32) && !defined(_WIN64)
+			if (offset >= size_) return;
+
+			const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+			const size_t begin = offset / page * page;
+			const size_t end = std::min(offset + length, size_);
+			madvise(data_ + begin, end - begin, MADV_WILLNEED);
+#endif
+		}
+
+		inline bool is_open() const { return data_ != NULL; }
+		inline const unsigned char* data() const { return data_; }
+		inline size_t size() const { return size_; }
+
+	private:
+		mapped_file(const mapped_file&);
+		mapped_file& operator=(const mapped_file&);
+
+		unsigned char*	data_;	///< the mapped memory
+		size_t			size_;	///< the size of the file
+	};
+
+	/// The pixel type codes of the pack files
+	template <typename T> struct pack_pixel_type					{ enum { value = 0 }; };
+	template <> struct pack_pixel_type<unsigned char>			{ enum { value = 1 }; };
+	template <> struct pack_pixel_type<char>					{ enum { value = 2 }; };
+	template <> struct pack_pixel_type<unsigned short>			{ enum { value = 3 }; };
+	template <> struct pack_pixel_type<short>					{ enum { value = 4 }; };
+	template <> struct pack_pixel_type<unsigned int>			{ enum { value = 5 }; };
+	template <> struct pack_pixel_type<int>						{ enum { value = 6 }; };
+	template <> struct pack_pixel_type<float>					{ enum { value = 7 }; };
+	template <> struct pack_pixel_type<double>					{ enum { value = 8 }; };
+
+	/**
+	 *	@brief	The header of the versioned pack files, in the byte order of the machine.<br>
+	 *			The frames follow the header one after another, each at a multiple of #alignment bytes,
+	 *			and the index at the end gives the offsets of the frames and their timestamps if any.
+	 */
+	struct pack_header
+	{
+		static const unsigned int current_version = 1;	///< the version written
+		static const unsigned int alignment = 64;		///< the alignment of the frames
+		static const unsigned int timestamps = 1;		///< the flag of the timestamps in the index
+
+		char			magic[4];		///< "AUXP"
+		unsigned int	version;		///< the version of the format
+		unsigned int	width;			///< the width of the frames
+		unsigned int	height;			///< the height of the frames
+		unsigned int	pixel_type;		///< the pixel type, see #pack_pixel_type
+		unsigned int	elem_size;		///< the size of a pixel in bytes
+		unsigned int	layout;			///< the layout of the frames, see ::image_layout
+		unsigned int	flags;			///< #timestamps if the index has timestamps
+		arma::u64		frame_count;	///< the number of frames, 0 until the file is closed
+		arma::u64		index_offset;	///< the offset of the index, 0 until the file is closed
+
+		/// Whether the header begins with the magic
+		inline bool valid() const { return memcmp(magic, "AUXP", 4) == 0; }
+
+		/// The offset of the first frame
+		static inline size_t data_offset() { return (sizeof(pack_header) + alignment - 1) / alignment * alignment; }
+
+		/// The distance between two frames
+		inline size_t frame_stride() const { return ((size_t)elem_size * width * height + alignment - 1) / alignment * alignment; }
+	};
+
+	/**
+	 *	@brief	A reader of pack files.<br>
+	 *			The file is memory mapped, so a frame is a view into the page cache which is accessed in constant time.
+	 *	@note	A versioned file (see #pack_header) is detected by its magic. Otherwise, the file is a legacy one:
+	 *			the width, the height and the number of frames as @c unsigned @c int, followed by the row-major frames.
+	 *			A versioned file which was not closed has no index; the frames written completely are read then.
+	 *			The frame after the one accessed is read ahead.
+	 */
+	class pack_reader
+	{
+	public:
+		typedef arma::uword	size_type;
+
+		/// Constructor
+		pack_reader(): width_(0), height_(0), frames_(0), version_(0), pixel_type_(0), elem_size_(0), layout_(row_major) {}
+
+		/// Constructor, opens a pack file
+		explicit pack_reader(const std::string& path)
+			: width_(0), height_(0), frames_(0), version_(0), pixel_type_(0), elem_size_(0), layout_(row_major) { open(path); }
+
+		/// Opens a pack file.
+		void open(const std::string& path)
+		{
+			if (!file_.open(path) || file_.size() < legacy_header_size)
+				FETCH_ERROR("Given path does not exist!");
+
+			offsets_.clear();
+			timestamps_.clear();
+
+			pack_header header;
+			if (file_.size() >= sizeof(header) && (memcpy(&header, file_.data(), sizeof(header)), header.valid()))
+				open_versioned(header);
+			else {
+				unsigned int legacy[3];
+				memcpy(legacy, file_.data(), sizeof(legacy));
+				width_ = legacy[0];
+				height_ = legacy[1];
+				frames_ = legacy[2];
+				version_ = pixel_type_ = elem_size_ = 0;
+				layout_ = row_major;
+			}
+		}
+
+		/// Closes the pack file.
+		void close() { file_.close(); }
+
+		inline bool is_open() const { return file_.is_open(); }
+		inline size_type width() const { return width_; }
+		inline size_type height() const { return height_; }
+
+		/// Get the number of frames
+		inline size_type frame_count() const { return frames_; }
+
+		/// Get the version of the format, 0 for a legacy file
+		inline unsigned int version() const { return version_; }
+
+		/// Get the layout of the frames, ::row_major for a legacy file
+		inline image_layout layout() const { return layout_; }
+
+		/// Whether the frames have timestamps
+		inline bool has_timestamps() const { return !timestamps_.empty(); }
+
+		/// Get the timestamp of a frame, NaN if it has none
+		inline double timestamp(size_type k) const
+		{
+			return k < timestamps_.size() ? timestamps_[k] : std::numeric_limits<double>::quiet_NaN();
+		}
+
+		/**
+		 *	@brief	Get a frame as a view into the file, in the layout of the file.
+		 *	@note	The view is valid until the reader is closed. The file is mapped read-only, so the pixels cannot be written.
+		 */
+		template <typename pixel_type>
+		image_view<const pixel_type> frame(size_type k) const
+		{
+			if (version_ && (elem_size_ != sizeof(pixel_type) || (pixel_type_ && pack_pixel_type<pixel_type>::value != 0 && pixel_type_ != (unsigned int)pack_pixel_type<pixel_type>::value)))
+				FETCH_ERROR("Pixel type does not match the pack file");
+
+			if (k >= frames_)
+				FETCH_ERROR("Frame is out of the pack file");
+
+			const size_t bytes = sizeof(pixel_type) * width_ * height_;
+			const size_t offset = version_ ? (size_t)offsets_[k] : legacy_header_size + k * bytes;
+			if (offset > file_.size() || bytes > file_.size() - offset)
+				FETCH_ERROR("Frame is out of the pack file");
+
+			file_.will_need(offset + bytes, bytes);
+			return image_view<const pixel_type>((const pixel_type*)(file_.data() + offset), width_, height_, 0, layout_);
+		}
+
+	private:
+		pack_reader(const pack_reader&);
+		pack_reader& operator=(const pack_reader&);
+
+		/// Reads the header and the index of a versioned file.
+		void open_versioned(const pack_header& header)
+		{
+			if (header.version == 0 || header.version > pack_header::current_version || header.elem_size == 0)
+				FETCH_ERROR("Unsupported pack file version");
+
+			width_ = header.width;
+			height_ = header.height;
+			version_ = header.version;
+			pixel_type_ = header.pixel_type;
+			elem_size_ = header.elem_size;
+			layout_ = header.layout == col_major ? col_major : row_major;
+
+			// a damaged header may hold any values, so the sizes are bounded without overflow
+			const arma::u64 size = file_.size();
+			const arma::u64 pixels = (arma::u64)header.width * header.height;
+			const bool fits = pixels <= size / header.elem_size;
+			const arma::u64 bytes = fits ? pixels * header.elem_size : 0;
+
+			const arma::u64 entry = (header.flags & pack_header::timestamps) ? 16 : 8;
+			if (header.index_offset && header.index_offset <= size &&
+				header.frame_count <= (size - header.index_offset) / entry) {
+				const size_t n = (size_t)header.frame_count;
+				offsets_.resize(n);
+				if (n) memcpy(&offsets_[0], file_.data() + header.index_offset, n * 8);
+				if (n && (header.flags & pack_header::timestamps)) {
+					timestamps_.resize(n);
+					memcpy(&timestamps_[0], file_.data() + header.index_offset + n * 8, n * 8);
+				}
+
+				// every frame must lie inside the file, so that #frame never reads past the mapping
+				for (size_t k = 0 ; k < n ; k++)
+					if (!fits || offsets_[k] > size || bytes > size - offsets_[k])
+						FETCH_ERROR("Damaged pack file index");
+			} else if (fits) {
+				// not closed, the frames are found at their fixed positions
+				const size_t stride = header.frame_stride();
+				const size_t start = pack_header::data_offset();
+				for (size_t offset = start ; stride && offset <= size && bytes <= size - offset ; offset += stride)
+					offsets_.push_back(offset);
+			}
+			frames_ = offsets_.size();
+		}
+
+		static const size_t legacy_header_size = sizeof(unsigned int) * 3;	///< the size of the legacy header
+
+		mapped_file				file_;			///< the mapped pack file
+		size_type				width_;			///< the width of the frames
+		size_type				height_;		///< the height of the frames
+		size_type				frames_;		///< the number of frames
+		unsigned int			version_;		///< the version of the format, 0 for a legacy file
+		unsigned int			pixel_type_;	///< the pixel type code
+		unsigned int			elem_size_;		///< the size of a pixel
+		image_layout			layout_;		///< the layout of the frames
+		std::vector<arma::u64>	offsets_;		///< the offsets of the frames
+		std::vector<double>		timestamps_;	///< the timestamps of the frames
+	};
+
+	/**
+	 *	@brief	A writer of versioned pack files, see #pack_header.
+	 *	@note	The frames are stored in the given layout; an image or a view in the other layout is transposed on the way.
+	 *			The index is written when the writer is closed. Errors are reported as #fetch_error.
+	 */
+	template <typename pixel_type>
+	class pack_writer
+	{
+	public:
+		typedef arma::uword	size_type;
+
+		/**
+		 *	@brief	Constructor, creates a pack file.
+		 *	@param layout	the layout of the frames in the file, ::col_major as Image by default
+		 */
+		pack_writer(const std::string& path, size_type width, size_type height, image_layout layout = col_major)
+		{
+			memset(&header_, 0, sizeof(header_));
+			memcpy(header_.magic, "AUXP", 4);
+			header_.version = pack_header::current_version;
+			header_.width = (unsigned int)width;
+			header_.height = (unsigned int)height;
+			header_.pixel_type = pack_pixel_type<pixel_type>::value;
+			header_.elem_size = sizeof(pixel_type);
+			header_.layout = layout;
+
+			out_.open(path.c_str(), std::ios::binary | std::ios::trunc);
+			if (!out_.is_open())
+				FETCH_ERROR("Cannot create the pack file");
+
+			// the header is written again with the index
+			std::vector<char> head(pack_header::data_offset(), 0);
+			memcpy(&head[0], &header_, sizeof(header_));
+			out_.write(&head[0], head.size());
+		}
+
+		/// Destructor, closes the file.
+		~pack_writer()
+		{
+			try {
+				close();
+			} catch (...) {
+			}
+		}
+
+		/// Appends a frame without timestamp.
+		void write(const Image<pixel_type>& frame)
+		{
+			write(frame, std::numeric_limits<double>::quiet_NaN());
+		}
+
+		/// Appends a frame with its timestamp.
+		void write(const Image<pixel_type>& frame, double timestamp)
+		{
+			write(image_view<pixel_type>(const_cast<pixel_type*>(frame.memptr()), frame.width(), frame.height()), timestamp);
+		}
+
+		/// Appends a frame without timestamp.
+		void write(const image_view<pixel_type>& frame)
+		{
+			write(frame, std::numeric_limits<double>::quiet_NaN());
+		}
+
+		/// Appends a frame with its timestamp.
+		void write(const image_view<pixel_type>& frame, double timestamp)
+		{
+			if (!out_.is_open())
+				FETCH_ERROR("Pack file is closed");
+			if (frame.width() != header_.width || frame.height() != header_.height)
+				FETCH_ERROR("Frame size does not match the pack file");
+
+			const image_layout layout = (image_layout)header_.layout;
+			const size_type lines = (layout == col_major) ? frame.width() : frame.height();
+			const size_type length = (layout == col_major) ? frame.height() : frame.width();
+			const size_t bytes = sizeof(pixel_type) * frame.n_elem;
+
+			offsets_.push_back((arma::u64)out_.tellp());
+			timestamps_.push_back(timestamp);
+			if (timestamp == timestamp) header_.flags |= pack_header::timestamps;
+
+			if (frame.layout() == layout) {
+				if (frame.stride() == length)
+					out_.write((const char*)frame.memptr(), bytes);
+				else {
+					for (size_type i = 0 ; i < lines ; i++)
+						out_.write((const char*)(frame.memptr() + i * frame.stride()), sizeof(pixel_type) * length);
+				}
+			} else {
+				// the lines of the frame are the columns of the buffer
+				pooled_image<pixel_type> buffer(lines, length);
+				detail::transpose_copy(frame.memptr(), frame.stride(), buffer->memptr(), length, lines, length);
+				out_.write((const char*)buffer->memptr(), bytes);
+			}
+
+			const std::vector<char> padding(header_.frame_stride() - bytes, 0);
+			if (!padding.empty())
+				out_.write(&padding[0], padding.size());
+
+			if (!out_.good())
+				FETCH_ERROR("Cannot write the pack file");
+		}
+
+		/// Writes the index and closes the file.
+		void close()
+		{
+			if (!out_.is_open()) return;
+
+			header_.frame_count = offsets_.size();
+			header_.index_offset = (arma::u64)out_.tellp();
+			if (!offsets_.empty())
+				out_.write((const char*)&offsets_[0], sizeof(arma::u64) * offsets_.size());
+			if ((header_.flags & pack_header::timestamps) && !timestamps_.empty())
+				out_.write((const char*)&timestamps_[0], sizeof(double) * timestamps_.size());
+
+			out_.seekp(0);
+			out_.write((const char*)&header_, sizeof(header_));
+
+			const bool good = out_.good();
+			out_.close();
+			if (!good)
+				FETCH_ERROR("Cannot write the pack file");
+		}
+
+		/// Get the number of frames written
+		inline size_type frame_count() const { return offsets_.size(); }
+
+	private:
+		pack_writer(const pack_writer&);
+		pack_writer& operator=(const pack_writer&);
+
+		std::ofstream			out_;			///< the pack file
+		pack_header				header_;		///< the header
+		std::vector<arma::u64>	offsets_;		///< the offsets of the frames
+		std::vector<double>		timestamps_;	///< the timestamps of the frames, NaN for none
+	};
+
+	namespace detail
+	{
+		/// Returns the number of trailing zero bits of a non-zero @c x.
+		inline unsigned int trailing_zeros(unsigned int x)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, x);
+			return (unsigned int)index;
 #else
+			return (unsigned int)__builtin_ctz(x);
+#endif
+		}
+
+		/// Appends a decimal digit to @c value, which saturates at 65536.
+		inline unsigned int append_digit(unsigned int value, char c)
+		{
+			value = value * 10 + (unsigned int)(c - '0');
+			return value > 0xFFFF ? 0x10000 : value;
+		}
+
+#if ENABLE_SSE2
+		/// The bit mask of the decimal digits among 16 characters.
+		inline unsigned int digit_mask_sse2(const char* p)
+		{
+			// c - '0' < 10 as an unsigned comparison
+			const __m128i x = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi8((char)('0' + 128)));
+			return (unsigned int)_mm_movemask_epi8(_mm_cmplt_epi8(x, _mm_set1_epi8((char)(-128 + 10))));
+		}
+
+		/// Converts the @c len <= 5 digits at @c p at once, weighting them by the powers of 10 in a multiply-add.
+		inline unsigned int decimal_sse2(const char* p, unsigned int len)
+		{
+			static const short weights[6][8] = {
+				{ 0 }, { 1 }, { 10, 1 }, { 100, 10, 1 }, { 1000, 100, 10, 1 }, { 10000, 1000, 100, 10, 1 }
+			};
+
+			// the characters after the digits have zero weights
+			const __m128i digits = _mm_sub_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_set1_epi8('0'));
+			__m128i sum = _mm_madd_epi16(_mm_unpacklo_epi8(digits, _mm_setzero_si128()), _mm_loadu_si128((const __m128i*)weights[len]));
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+			sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+			return (unsigned int)_mm_cvtsi128_si32(sum);
+		}
+
+		/**
+		 *	@brief	Parses the decimal numbers from @c p with SSE2 while enough characters remain.<br>
+		 *			The digits and the separators of 16 characters are classified at once, and each number that ends among them
+		 *			is converted by a single multiply-add, so that there is no branch per character.
+		 *	@return	the number of numbers parsed; @c p is moved to the first character that is not parsed, which is not inside a number
+		 */
+		inline size_t parse_decimal_sse2(const char*& p, const char* end, unsigned short* dst, size_t n)
+		{
+			size_t k = 0;
+			while (k < n && p + 24 <= end) {
+				const unsigned int mask = digit_mask_sse2(p);
+				const unsigned int separators = ~mask & 0xFFFF;
+
+				unsigned int pos = 0;
+				while (k < n) {
+					const unsigned int start = mask >> pos;
+					if (!start) { pos = 16; break; }
+					pos += trailing_zeros(start);
+
+					const unsigned int stop = separators >> pos;
+					if (!stop) break;	// continued in the next 16 characters
+
+					const unsigned int len = trailing_zeros(stop);
+					unsigned int value = 0;
+					if (len <= 5)
+						value = decimal_sse2(p + pos, len);
+					else {
+						for (unsigned int i = 0 ; i < len ; i++)
+							value = append_digit(value, p[pos + i]);
+					}
+					dst[k++] = (unsigned short)std::min(value, 0xFFFFu);
+					pos += len;
 				}
+
+				if (pos == 0) break;	// too long to be a pixel
+				p += pos;
+			}
+			return k;
+		}
+#endif
+
+		/**
+		 *	@brief	Parses the decimal numbers separated by any non-digit characters in [p, end) into @c dst, up to @c n numbers.
+		 *	@return	the number of numbers parsed; the numbers saturate at 65535
+		 */
+		inline size_t parse_decimal(const char* p, const char* end, unsigned short* dst, size_t n)
+		{
+			size_t k = 0;
+#if ENABLE_SSE2
+			if (simd_support() >= simd_sse2)
+				k = parse_decimal_sse2(p, end, dst, n);
 #endif
 
+			unsigned int value = 0;
+			bool in_number = false;
+			for ( ; p < end && k < n ; p++) {
+				if ((unsigned char)(*p - '0') < 10) {
+					value = append_digit(value, *p);
+					in_number = true;
+				} else if (in_number) {
+					dst[k++] = (unsigned short)std::min(value, 0xFFFFu);
+					value = 0;
+					in_number = false;
+				}
+			}
+
+			if (in_number && k < n)
+				dst[k++] = (unsigned short)std::min(value, 0xFFFFu);
+			return k;
+		}
+
+		/// Whether all bytes are decimal digits or separators, i.e. white spaces, commas or semicolons.
+		inline bool is_decimal_text(const unsigned char* data, size_t size)
+		{
+			for (size_t i = 0 ; i < size ; i++)
+				if ((unsigned char)(data[i] - '0') >= 10 && !isspace(data[i]) && data[i] != ',' && data[i] != ';')
+					return false;
+			return true;
+		}
+
+		/// Stores a row-major 16-bit frame into a grayscale image.
+		inline void store_raw(const image_view<const unsigned short>& frame, Image<unsigned short>& image)
+		{
+			image.resize(frame.width(), frame.height());
+			transpose_copy_parallel(frame.memptr(), frame.stride(), image.memptr(), image.n_rows, frame.width(), frame.height());
+		}
+
+		/// Stores a row-major 16-bit frame into a grayscale image, converting the pixels with saturation through a pooled buffer.
+		template <typename pixel_type>
+		void store_raw(const image_view<const unsigned short>& frame, Image<pixel_type>& image)
+		{
+			pooled_image<unsigned short> gray(frame.width(), frame.height());
+			store_raw(frame, *gray);
+			image.resize(frame.width(), frame.height());
+			convert(gray->memptr(), image.memptr(), image.n_elem);
+		}
+	}
+
+	/// The formats of 16-bit raw frames, see #raw_reader
+	enum raw_format
+	{
+		raw_auto,	///< detected from the size and the bytes of the file
+		raw_binary,	///< native binary
+		raw_text	///< decimal text
+	};
+
+	/**
+	 *	@brief	A reader of 16-bit raw frames, as recorded by thermal cameras.<br>
+	 *			A frame is either native binary, the row-major pixels in the byte order of the machine,
+	 *			or text, the row-major pixels in decimal separated by spaces, tabs, new lines, commas or semicolons.
+	 *	@note	The size and the format of the frames are given by a header, <tt>width 640 height 480 format binary</tt> in text
+	 *			(an @c = may follow the keys, and the format is @c binary or @c text), named after the whole name of the frame,
+	 *			e.g. <tt>frame.raw.hdr</tt> for <tt>frame.raw</tt>. Otherwise, the configured size and format are used,
+	 *			which are @c RAW_16BIT_WIDTH x @c RAW_16BIT_HEIGHT and ::raw_auto by default.
+	 *			With ::raw_auto, a file is binary if it has exactly 2 x width x height bytes, not all of which are
+	 *			decimal digits or separators; any other file is text.
+	 */
+	class raw_reader
+	{
+	public:
+		typedef arma::uword	size_type;
+
+		/// Constructor
+		raw_reader(size_type width = RAW_16BIT_WIDTH, size_type height = RAW_16BIT_HEIGHT): width_(width), height_(height), format_(raw_auto) {}
+
+		/// Sets the size of the frames without header.
+		inline void set_size(size_type width, size_type height) { width_ = width; height_ = height; }
+
+		/// Sets the format of the frames without header.
+		inline void set_format(raw_format format) { format_ = format; }
+
+		inline size_type width() const { return width_; }
+		inline size_type height() const { return height_; }
+		inline raw_format format() const { return format_; }
+
+		/**
+		 *	@brief	Reads the size and the format of the frames from a header file.
+		 *	@return	@c false if there is no such file or it gives neither the size nor the format
+		 */
+		bool load_header(const std::string& path)
+		{
+			std::ifstream in(path.c_str());
+			if (!in.is_open()) return false;
+
+			std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			std::replace(text.begin(), text.end(), '=', ' ');
+
+			size_type width = 0, height = 0;
+			bool has_format = false;
+			std::istringstream tokens(text);
+			std::string key, value;
+			while (tokens >> key >> value) {
+				if (key == "width") width = (size_type)strtoul(value.c_str(), NULL, 10);
+				else if (key == "height") height = (size_type)strtoul(value.c_str(), NULL, 10);
+				else if (key == "format" && (value == "binary" || value == "text")) {
+					set_format(value == "binary" ? raw_binary : raw_text);
+					has_format = true;
+				}
+			}
+
+			if (width == 0 || height == 0) return has_format;
+			set_size(width, height);
+			return true;
+		}
+
+		/**
+		 *	@brief	Reads a frame into a grayscale image.
+		 *	@note	The file is read at once through a memory map, and binary frames are transposed straight from it.
+		 */
+		template <typename pixel_type>
+		void read(const std::string& file, Image<pixel_type>& image) const
+		{
+			raw_reader header(*this);
+			header.load_header(file + ".hdr");
+			const size_type width = header.width(), height = header.height();
+			const size_t n = (size_t)width * height;
+
+			mapped_file mapped;
+			if (!mapped.open(file))
+				FETCH_ERROR("Cannot read the raw file");
+
+			const bool binary = header.format() == raw_binary ||
+				(header.format() == raw_auto && mapped.size() == n * sizeof(unsigned short) && !detail::is_decimal_text(mapped.data(), mapped.size()));
+			if (binary) {
+				if (mapped.size() != n * sizeof(unsigned short))
+					FETCH_ERROR("The raw file does not match the frame size");
+				detail::store_raw(image_view<const unsigned short>((const unsigned short*)mapped.data(), width, height, 0, row_major), image);
+				return;
+			}
+
+			// the rows of the frame are the columns of the buffer
+			pooled_image<unsigned short> buffer(height, width);
+			const char* text = (const char*)mapped.data();
+			if (detail::parse_decimal(text, text + mapped.size(), buffer->memptr(), n) < n)
+				FETCH_ERROR("Not enough pixels in the raw file");
+			detail::store_raw(image_view<const unsigned short>(buffer->memptr(), width, height, 0, row_major), image);
+		}
+
+	private:
+		size_type	width_;		///< the width of the frames without header
+		size_type	height_;	///< the height of the frames without header
+		raw_format	format_;	///< the format of the frames without header
+	};
+
+	namespace detail
+	{
+		/**
+		 *	@brief	Compares file names in natural order, where the runs of digits are compared by their values,
+		 *			so that @c frame2.png comes before @c frame10.png.
+		 *	@note	The names that differ only in leading zeros are ordered as strings.
+		 */
+		inline bool natural_less(const std::string& a, const std::string& b)
+		{
+			size_t i = 0, j = 0;
+			while (i < a.size() && j < b.size()) {
+				if (isdigit((unsigned char)a[i]) && isdigit((unsigned char)b[j])) {
+					size_t ie = i, je = j;
+					while (ie < a.size() && isdigit((unsigned char)a[ie])) ie++;
+					while (je < b.size() && isdigit((unsigned char)b[je])) je++;
+
+					// the significant digits, a longer one is greater
+					while (i + 1 < ie && a[i] == '0') i++;
+					while (j + 1 < je && b[j] == '0') j++;
+					if (ie - i != je - j) return ie - i < je - j;
+					for ( ; i < ie ; i++, j++)
+						if (a[i] != b[j]) return a[i] < b[j];
+				} else {
+					if (a[i] != b[j]) return (unsigned char)a[i] < (unsigned char)b[j];
+					i++;
+					j++;
+				}
+			}
+
+			if (i < a.size() || j < b.size()) return a.size() - i < b.size() - j;
+			return a < b;
+		}
+
+		/// Sorts file names in natural order, see #natural_less.
+		inline void sort_natural(std::vector<std::string>& names)
+		{
+#if defined(USE_PPL)
+			concurrency::parallel_sort(names.begin(), names.end(), natural_less);
+#else
+			std::sort(names.begin(), names.end(), natural_less);
+#endif
+		}
+
+		/**
+		 *	@brief	The file name of the cached listing of a directory, a 64-bit FNV-1a hash of the key in hexadecimal.
+		 *	@param key	the directory and whatever selects its files
+		 */
+		inline std::string listing_name(const std::string& key)
+		{
+			arma::u64 hash = 14695981039346656037ULL;
+			for (size_t i = 0 ; i < key.size() ; i++)
+				hash = (hash ^ (unsigned char)key[i]) * 1099511628211ULL;
+
+			std::ostringstream name;
+			name << "image_fetcher_" << std::hex << std::setw(16) << std::setfill('0') << hash << ".lst";
+			return name.str();
+		}
+
+		/**
+		 *	@brief	Reads a cached listing, the sorted file names of a directory.
+		 *	@param stamp	the last write time of the directory, which must match that of the listing
+		 *	@return	@c false if there is no valid listing
+		 */
+		inline bool read_listing(const std::string& path, const std::string& key, long long stamp, std::vector<std::string>& names)
+		{
+			std::ifstream in(path.c_str());
+			if (!in.is_open()) return false;
+
+			std::string magic, line;
+			long long cached_stamp = 0;
+			size_t count = 0;
+			if (!std::getline(in, magic) || magic != "image_fetcher listing 1" ||
+				!std::getline(in, line) || line != key ||
+				!(in >> cached_stamp >> count) || cached_stamp != stamp || !std::getline(in, line))
+				return false;
+
+			std::vector<std::string> cached;
+			cached.reserve(count);
+			while (cached.size() < count && std::getline(in, line)) {
+				// a name must stay inside the directory
+				if (line.empty() || line == "." || line == ".." || line.find_first_of("/\\") != std::string::npos)
+					return false;
+				cached.push_back(line);
+			}
+			if (cached.size() != count) return false;	// being written
+
+			names.swap(cached);
+			return true;
+		}
+
+		/**
+		 *	@brief	Creates the directory of the cached listings of the current user.
+		 *	@param temp	the temporary directory
+		 *	@param [out] dir	the directory of the cached listings
+		 *	@return	@c false if it cannot be created, or on POSIX if it is not a directory owned by and private to the user
+		 */
+		inline bool listing_directory(const std::string& temp, std::string& dir)
+		{
+#if defined(_WIN32) || defined(_WIN64)
+			// the temporary directory is already per user
+			dir = temp + "\\image_fetcher";
+			return CreateDirectoryA(dir.c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+			std::ostringstream name;
+			name << temp << "/image_fetcher-" << geteuid();
+			dir = name.str();
+
+			mkdir(dir.c_str(), 0700);
+			struct stat st;
+			return lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == geteuid() && (st.st_mode & 077) == 0;
+#endif
+		}
+
+		/**
+		 *	@brief	Writes a cached listing, see #read_listing.<br>
+		 *			The listing is written to a unique @c temp_path and renamed, so that a reader never sees a partial one.
+		 */
+		inline void write_listing(const std::string& path, const std::string& temp_path, const std::string& key, long long stamp, const std::vector<std::string>& names)
+		{
+			{
+				std::ofstream out(temp_path.c_str());
+				if (!out.is_open()) return;
+
+				out << "image_fetcher listing 1\n" << key << "\n" << stamp << " " << names.size() << "\n";
+				for (size_t i = 0 ; i < names.size() ; i++)
+					out << names[i] << "\n";
+				if (!out.good()) {
+					out.close();
+					std::remove(temp_path.c_str());
+					return;
+				}
+			}
+
+			if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+				std::remove(path.c_str());	// the target cannot be replaced on Windows
+				if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+					std::remove(temp_path.c_str());
+			}
+		}
+	}
+
+	//!	An implementation of image fetcher.
+	class image_fetcher
+	{
+	public:
+		/// Constructor
+		image_fetcher(): width_(0), height_(0), numframes_(0), pos_(0) {}
+
+		/**
+		 *	@brief	Open file or directory
+		 *	@param cached	whether the listing of a directory is cached in the temporary directory, see #list_directory
+		 */
+		void open(const std::string& path, bool cached = true)
+		{
+#if defined(USE_BOOST) && defined(USE_OPENCV)
+			files_.clear();
+			pack_.close();
+			boost::filesystem::path p(path);
+			if (boost::filesystem::is_directory(p)) {
+				dir_ = boost::filesystem::absolute(p).string();
+				list_directory(cached);
+
 				if (files_.empty())
 					FETCH_ERROR("Nothing to fetch");
 
+#ifdef USE_16BIT_IMAGE
+				// the size of all the frames in the directory
+				raw_.load_header((p / "raw.hdr").string());
+#endif
+
 				pos_ = 0;
 			} else if (boost::filesystem::is_regular_file(p)) {
 				cap_.open(path);
@@ -145,6 +987,7 @@ namespace auxiliary
             } else
 				FETCH_ERROR("Given path does not exist!");
 #elif defined(USE_OPENCV)
+			(void)cached;	// only directories are cached
             cap_.open(path);
             
             if (cap_.isOpened())
@@ -152,24 +995,20 @@ namespace auxiliary
             else
 				FETCH_ERROR("Given path does not exist!");
 #else
+			(void)cached;	// only directories are cached
             return open_pack(path);
 #endif
 		}
         
         void open_pack(const std::string& path)
         {
-            fin_.open(path.c_str(), std::ios::binary); // std::string param is supported C++11
-            
-            if (fin_.is_open()) {
-                // try to read pack file
-                cout << "Read pack file" << endl;
-                fin_.read((char *)&width_, sizeof(unsigned int));
-                fin_.read((char *)&height_, sizeof(unsigned int));
-                fin_.read((char *)&numframes_, sizeof(unsigned int));
-                dir_ = path.substr(0, path.find_last_of(PathSeparator()));
-                pos_ = 0;
-			} else
-				FETCH_ERROR("Given path does not exist!");
+            // try to read pack file
+            pack_.open(path);
+            width_ = (unsigned int)pack_.width();
+            height_ = (unsigned int)pack_.height();
+            numframes_ = (unsigned int)pack_.frame_count();
+            dir_ = path.substr(0, path.find_last_of(PathSeparator()));
+            pos_ = 0;
         }
 
 		//!	Connect to device
@@ -203,57 +1042,212 @@ namespace auxiliary
 		void retrieve(Image<pixel_type>& image)
 		{
 #ifdef USE_OPENCV
-			cv::Mat frame;
-            
 			if (cap_.isOpened()) {
-				cap_.retrieve(frame);
-                image = bgr2gray<pixel_type>(frame);
+				cap_.retrieve(frame_);
+				bgr2gray(frame_, image);
 			} else if(!files_.empty()) {
 				//std::cout << files[pos].c_str() << " "; /*std::endl;*/
-#ifdef USE_16BIT_IMAGE
-                // simulate different image format
-                //std::cout << "Simulate 16 bit image" << std::endl;
-                //frame.clone().convertTo(frame, CV_16U);
-				//frame = cv::Mat(320, 240, cv::DataType<pixel_type>::type);
-				//pixel_type* ptr = frame.ptr<pixel_type>();
-				arma::Mat<pixel_type> gray(RAW_16BIT_WIDTH, RAW_16BIT_HEIGHT);
-				pixel_type* ptr = gray.memptr();
-				
-				FILE* f = fopen(files_[pos_++].c_str(), "r");
-
-				for (int r = 0 ; r < RAW_16BIT_HEIGHT ; r++) {
-					for (int c = 0 ; c < RAW_16BIT_WIDTH ; c++)
-						fscanf(f, "%uh ", ptr++);
-				}
-				
-				fclose(f);
-				image = Image<pixel_type>(gray.t());
+				read_file(files_[pos_++], image);
+			} else if (pack_.is_open()) {
 #else
-				frame = cv::imread(files_[pos_++]);
-                image = bgr2gray<pixel_type>(frame);
+            if (pack_.is_open()) {
 #endif
-			} else if (fin_.is_open()) {
-#else
-            if (fin_.is_open()) {
-#endif
-                Image<pixel_type> temp(height_, width_);
-                fin_.read((char *)temp.memptr(), sizeof(pixel_type) * width_ * height_);
-                image = Image<pixel_type>(temp.t());
+                // copied or transposed from the mapped file in a single pass
+                const image_view<const pixel_type> frame = pack_.frame<pixel_type>(pos_);
+                image.resize(width_, height_);
+                if (frame.layout() == col_major)
+                    memcpy(image.memptr(), frame.memptr(), sizeof(pixel_type) * frame.n_elem);
+                else
+                    detail::transpose_copy_parallel(frame.memptr(), frame.stride(), image.memptr(), image.n_rows, frame.width(), frame.height());
                 ++pos_;
             }
 		}
 
+		/**
+		 *	@brief	Returns the grabbed frame of a pack file as a view into the mapped file, without copy.
+		 *	@note	The view is valid until the fetcher is reopened or destroyed, and is read-only as the file is mapped read-only.
+		 */
+        template <typename pixel_type>
+		image_view<const pixel_type> retrieve_view()
+		{
+			if (!pack_.is_open())
+				FETCH_ERROR("Only the frames of pack files can be viewed");
+			return pack_.frame<pixel_type>(pos_++);
+		}
+
+		/**
+		 *	@brief	Get the number of frames
+		 *	@return	0 if it is not known, as for cameras
+		 */
+		size_t frame_count() const
+		{
+#ifdef USE_OPENCV
+			if (cap_.isOpened()) {
+				// get() is not const in OpenCV 2
+				const double n = const_cast<cv::VideoCapture&>(cap_).get(CV_CAP_PROP_FRAME_COUNT);
+				return n > 0 ? (size_t)n : 0;
+			}
+#endif
+			return files_.empty() ? numframes_ : files_.size();
+		}
+
+		//!	Get the number of the next frame to grab, once the previous frame is retrieved
+		size_t position() const
+		{
+#ifdef USE_OPENCV
+			if (cap_.isOpened()) {
+				const double pos = const_cast<cv::VideoCapture&>(cap_).get(CV_CAP_PROP_POS_FRAMES);
+				return pos > 0 ? (size_t)pos : 0;
+			}
+#endif
+			return pos_;
+		}
+
+		/**
+		 *	@brief	Moves to a frame, so that it is the next one to grab.
+		 *	@note	A directory or a pack file is seeked in constant time, and a video as fast as its codec can.
+		 *			@c frame_count() moves to the end.
+		 */
+		void seek(size_t frame)
+		{
+#ifdef USE_OPENCV
+			if (cap_.isOpened()) {
+				if (!cap_.set(CV_CAP_PROP_POS_FRAMES, (double)frame))
+					FETCH_ERROR("Cannot seek the video");
+				return;
+			}
+#endif
+			if (frame > frame_count())
+				FETCH_ERROR("Frame is out of range");
+			pos_ = frame;
+		}
+
 		//!	Get current directory
 		inline std::string current_directory() const
 		{
 			return dir_;
 		}
 
+#ifdef USE_16BIT_IMAGE
+		/**
+		 *	@brief	Sets the size of the 16-bit raw frames without header.
+		 *	@note	A directory may give the size of its frames by @c raw.hdr, see #raw_reader.
+		 */
+		inline void set_raw_size(arma::uword width, arma::uword height) { raw_.set_size(width, height); }
+
+		/**
+		 *	@brief	Sets the format of the 16-bit raw frames without header.
+		 *	@note	A directory may give the format of its frames by @c raw.hdr, see #raw_reader.
+		 */
+		inline void set_raw_format(raw_format format) { raw_.set_format(format); }
+#endif
+
+		//!	Decodes an image file into a grayscale image.
+		template <typename pixel_type>
+		void read_file(const std::string& file, Image<pixel_type>& image) const
+		{
+#ifdef USE_16BIT_IMAGE
+			raw_.read(file, image);
+#elif defined(USE_OPENCV)
+			const cv::Mat frame = cv::imread(file);
+			if (frame.empty())
+				FETCH_ERROR("Cannot decode the image file");
+			bgr2gray(frame, image);
+#endif
+		}
+
 	private:
+		template <typename pixel_type> friend class image_prefetcher;
+
+#if defined(USE_BOOST) && defined(USE_OPENCV)
+		/**
+		 *	@brief	Lists the frames of #dir_ into #files_ in natural order, see detail::natural_less.<br>
+		 *			The names are read sequentially, and then the files are checked in parallel, which matters on network file systems.
+		 *	@param cached	whether the listing is read from and written to a private directory of the user in the temporary directory.
+		 *					A cached listing is used as long as the last write time of the directory does not change,
+		 *					so that reopening a huge directory does not scan it again. A directory written in the last
+		 *					couple of seconds is not cached.
+		 */
+		void list_directory(bool cached)
+		{
+			const boost::filesystem::path p(dir_);
+#ifdef USE_16BIT_IMAGE
+			const std::string key = dir_ + "|raw";
+#else
+			const std::string key = dir_ + "|" + supported_file_formats;
+#endif
+
+			boost::system::error_code ec;
+			const long long stamp = (long long)boost::filesystem::last_write_time(p, ec);
+			boost::filesystem::path cache;
+			if (cached && !ec) {
+				const boost::filesystem::path temp = boost::filesystem::temp_directory_path(ec);
+				std::string dir;
+				if (ec || !detail::listing_directory(temp.string(), dir))
+					cached = false;
+				else
+					cache = boost::filesystem::path(dir) / detail::listing_name(key);
+			}
+
+			std::vector<std::string> names;
+			if (!cached || !detail::read_listing(cache.string(), key, stamp, names)) {
+				boost::filesystem::directory_iterator end;
+				for (boost::filesystem::directory_iterator iter(p) ; iter != end ; ++iter) {
+					const boost::filesystem::path& entry = iter->path();
+#ifdef USE_16BIT_IMAGE
+					if (entry.extension() != ".hdr") // skip the headers
+#else
+					if (supported_file_formats.find(entry.extension().string()) != std::string::npos) // match the extension
+#endif
+						names.push_back(entry.filename().string());
+				}
+
+				// only the regular files
+				std::vector<char> regular(names.size());
+#if defined(USE_PPL)
+				concurrency::parallel_for(size_t(0), names.size(), [&](size_t i) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+				for (int si = 0 ; si < (int)names.size() ; si++) {
+					size_t i = (size_t)si;
+#else
+				for (size_t i = 0 ; i < names.size() ; i++) {
+#endif
+					boost::system::error_code status_ec;
+					regular[i] = boost::filesystem::is_regular_file(p / names[i], status_ec);
+#if defined(USE_PPL)
+				});
+#else
+				}
+#endif
+				size_t n = 0;
+				for (size_t i = 0 ; i < names.size() ; i++)
+					if (regular[i]) names[n++].swap(names[i]);
+				names.resize(n);
+
+				detail::sort_natural(names);
+
+				// a directory written within the resolution of its write time may change unnoticed
+				if (cached && stamp < (long long)time(NULL) - 1) {
+					const std::string temp_path = cache.string() + "." + boost::filesystem::unique_path().string();
+					detail::write_listing(cache.string(), temp_path, key, stamp, names);
+				}
+			}
+
+			files_.resize(names.size());
+			for (size_t i = 0 ; i < names.size() ; i++)
+				files_[i] = (p / names[i]).string();
+		}
+#endif
+
 #ifdef USE_OPENCV
 		cv::VideoCapture cap_;              ///< video capture
+		cv::Mat                     frame_; ///< the last video frame, of which buffer is reused
+#endif
+        pack_reader                 pack_;  ///< the pack file
+#ifdef USE_16BIT_IMAGE
+		raw_reader                  raw_;   ///< the reader of 16-bit raw frames
 #endif
-        std::ifstream               fin_;   ///<
         unsigned int                width_, height_;
         unsigned int                numframes_;
         
@@ -261,4 +1255,149 @@ namespace auxiliary
 		std::vector<std::string>    files_;	///< the image file names
 		size_t                      pos_;	///< the current frame number
 	};
+
+#ifdef USE_CXX11
+	/**
+	 *	@brief	Decodes the frames of an #image_fetcher ahead of the caller on background threads.<br>
+	 *			Up to @c depth decoded grayscale frames wait in a ring, so that the disk and decode latency overlaps with processing.
+	 *	@note	The images of a directory are decoded by @c n_threads threads, while videos, cameras and pack files
+	 *			are decoded by a single thread since their frames come in sequence. The frames are returned in order in any case.
+	 *			The fetcher must not be used directly while it is prefetched.
+	 */
+	template <typename pixel_type>
+	class image_prefetcher
+	{
+	public:
+		/**
+		 *	@brief	Constructor, starts to prefetch the frames from the current one.
+		 *	@param fetcher		an opened fetcher
+		 *	@param depth		the maximum number of decoded frames waiting to be retrieved
+		 *	@param n_threads	the number of decoder threads for a directory
+		 */
+		image_prefetcher(image_fetcher& fetcher, size_t depth = 4, size_t n_threads = 1)
+			: fetcher_(fetcher), ring_(std::max<size_t>(depth, 1)), sequential_(fetcher.files_.empty()), stop_(false)
+		{
+			for (size_t i = 0 ; i < ring_.size() ; i++)
+				ring_.push_back(slot());
+
+			read_ = claimed_ = sequential_ ? 0 : fetcher.pos_;
+			end_ = sequential_ ? (size_t)-1 : fetcher.files_.size();
+
+			const size_t n = sequential_ ? 1 : std::max<size_t>(n_threads, 1);
+			for (size_t i = 0 ; i < n ; i++)
+				threads_.push_back(std::thread(&image_prefetcher::decode, this));
+		}
+
+		/// Destructor, stops the decoder threads.
+		~image_prefetcher()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+			cond_.notify_all();
+			for (size_t i = 0 ; i < threads_.size() ; i++)
+				threads_[i].join();
+		}
+
+		/**
+		 *	@brief	Waits for the next frame.
+		 *	@return	@c false at the end of the frames
+		 *	@throw	the error that stopped the decoding of the next frame, if any
+		 */
+		bool grab()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			slot& s = ring_[read_ % ring_.size()];
+			cond_.wait(lock, [&] { return s.ready || read_ >= end_; });
+
+			if (!s.ready && error_)
+				std::rethrow_exception(error_);
+			return s.ready;
+		}
+
+		/// Returns the grabbed frame; its buffer is exchanged with that of @c image, which is reused for a later frame.
+		void retrieve(Image<pixel_type>& image)
+		{
+			slot& s = ring_[read_ % ring_.size()];
+			assert(s.ready);
+			image.swap(s.image);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				s.ready = false;
+				read_++;
+				if (!sequential_) fetcher_.pos_ = read_;
+			}
+			cond_.notify_all();
+		}
+
+	private:
+		image_prefetcher(const image_prefetcher&);
+		image_prefetcher& operator=(const image_prefetcher&);
+
+		/// A frame in the ring
+		struct slot
+		{
+			slot(): ready(false) {}
+
+			Image<pixel_type>	image;	///< the decoded frame
+			bool				ready;	///< whether the frame is decoded and not retrieved yet
+		};
+
+		/// The loop of a decoder thread, which claims the next frame as soon as its slot is free.
+		void decode()
+		{
+			for (;;) {
+				size_t k;
+				{
+					std::unique_lock<std::mutex> lock(mutex_);
+					// the slot of the frame k is free once the frame k - depth is retrieved
+					cond_.wait(lock, [&] { return stop_ || claimed_ >= end_ || claimed_ < read_ + ring_.size(); });
+					if (stop_ || claimed_ >= end_) return;
+					k = claimed_++;
+				}
+
+				slot& s = ring_[k % ring_.size()];
+				bool decoded = true;
+				std::exception_ptr error;
+				try {
+					if (sequential_) {
+						decoded = fetcher_.grab();
+						if (decoded) fetcher_.retrieve(s.image);
+					} else
+						fetcher_.read_file(fetcher_.files_[k], s.image);
+				} catch (...) {
+					error = std::current_exception();
+					decoded = false;
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					if (decoded)
+						s.ready = true;
+					else if (k < end_) {
+						// the frames end at k
+						end_ = k;
+						error_ = error;
+					}
+				}
+				cond_.notify_all();
+			}
+		}
+
+		image_fetcher&				fetcher_;	///< the source of the frames
+		circular_buffer<slot>		ring_;		///< the decoded frames, the frame k is in the slot k % depth
+		const bool					sequential_;///< whether the frames can only be decoded in sequence
+		std::vector<std::thread>	threads_;	///< the decoder threads
+
+		std::mutex					mutex_;		///< guards the indices below and the readiness of the slots
+		std::condition_variable		cond_;		///< signals retrieved and decoded frames
+		size_t						read_;		///< the next frame to retrieve
+		size_t						claimed_;	///< the next frame to decode
+		size_t						end_;		///< the number of frames, or the first frame which failed
+		std::exception_ptr			error_;		///< the error which stopped the decoding
+		bool						stop_;		///< whether the threads have to stop
+	};
+#endif
 }
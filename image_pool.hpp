@@ -0,0 +1,263 @@
+/**
+ *	@file		image_pool.hpp
+ *	@brief		Pool of aligned buffers for images and temporaries
+ *	@author		seonho.oh@gmail.com
+ *	@date		2015-03-02
+ *	@version	1.0
+ *
+ *	@section	LICENSE
+ *
+ *		Copyright (c) 2013-2015, Seonho Oh
+ *		All rights reserved. 
+ * 
+ *		Redistribution and use in source and binary forms, with or without  
+ *		modification, are permitted provided that the following conditions are  
+ *		met: 
+ * 
+ *		    * Redistributions of source code must retain the above copyright  
+ *		    notice, this list of conditions and the following disclaimer. 
+ *		    * Redistributions in binary form must reproduce the above copyright  
+ *		    notice, this list of conditions and the following disclaimer in the  
+ *		    documentation and/or other materials provided with the distribution. 
+ *		    * Neither the name of the <ORGANIZATION> nor the names of its  
+ *		    contributors may be used to endorse or promote products derived from  
+ *		    this software without specific prior written permission. 
+ * 
+ *		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS  
+ *		IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED  
+ *		TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A  
+ *		PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  
+ *		OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,  
+ *		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,  
+ *		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR  
+ *		PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF  
+ *		LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  
+ *		NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS  
+ *		SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+#pragma once
+
+#include <map>
+#include <vector>
+#include <cstdlib>
+#include <new>
+
+#if defined(USE_CXX11)
+#include <mutex>
+#elif defined(_WIN32) || defined(_WIN64)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace auxiliary
+{
+	namespace detail
+	{
+		/// The lock of an #image_pool.
+		class pool_mutex
+		{
+		public:
+#if defined(USE_CXX11)
+			inline void lock() { mutex_.lock(); }
+			inline void unlock() { mutex_.unlock(); }
+
+		private:
+			std::mutex mutex_;
+#elif defined(_WIN32) || defined(_WIN64)
+			pool_mutex() { InitializeCriticalSection(&section_); }
+			~pool_mutex() { DeleteCriticalSection(&section_); }
+			inline void lock() { EnterCriticalSection(&section_); }
+			inline void unlock() { LeaveCriticalSection(&section_); }
+
+		private:
+			pool_mutex(const pool_mutex&);
+			pool_mutex& operator=(const pool_mutex&);
+
+			CRITICAL_SECTION section_;
+#else
+			pool_mutex() { pthread_mutex_init(&mutex_, NULL); }
+			~pool_mutex() { pthread_mutex_destroy(&mutex_); }
+			inline void lock() { pthread_mutex_lock(&mutex_); }
+			inline void unlock() { pthread_mutex_unlock(&mutex_); }
+
+		private:
+			pool_mutex(const pool_mutex&);
+			pool_mutex& operator=(const pool_mutex&);
+
+			pthread_mutex_t mutex_;
+#endif
+		};
+
+		/// Holds a #pool_mutex in a scope.
+		class pool_lock
+		{
+		public:
+			explicit pool_lock(pool_mutex& mutex): mutex_(mutex) { mutex_.lock(); }
+			~pool_lock() { mutex_.unlock(); }
+
+		private:
+			pool_lock(const pool_lock&);
+			pool_lock& operator=(const pool_lock&);
+
+			pool_mutex& mutex_;
+		};
+	}
+
+#ifndef USE_CXX11
+	namespace detail
+	{
+		/**
+		 *	@brief	The pool shared by all the threads without @c thread_local.<br>
+		 *			It is a static member of a template, so that it is defined once in a header and constructed
+		 *			before @c main instead of at the first call, which is not thread-safe before C++11.
+		 */
+		template <typename pool_type>
+		struct shared_pool
+		{
+			static pool_type pool;
+		};
+
+		template <typename pool_type>
+		pool_type shared_pool<pool_type>::pool;
+	}
+#endif
+
+	/**
+	 *	@brief	Pool of aligned memory blocks, which are recycled by size.<br>
+	 *			Released blocks are kept in free lists keyed by their size and handed out again by #acquire,
+	 *			so processing frames of the same size allocates only for the first frame.
+	 *	@note	A block records its size, so it can be released to any pool, such as the pool of another thread.
+	 *			A pool is locked, so it may be shared by threads; still, #local gives the pool of the calling thread
+	 *			with @c USE_CXX11, which is not contended.
+	 *			The free lists keep up to #limit bytes; the blocks released beyond it are freed.
+	 */
+	class image_pool
+	{
+	public:
+		static const size_t alignment = 64;	///< the alignment of the blocks in bytes, enough for AVX-512 loads
+		static const size_t default_limit = size_t(256) << 20;	///< the default of #limit, 256 MB
+
+		/// Constructor
+		explicit image_pool(size_t limit = default_limit): limit_(limit), cached_bytes_(0) {}
+
+		/// Destructor, frees the cached blocks.
+		~image_pool() { trim(); }
+
+		/// Rounds a size up to the alignment, e.g. to pad the columns of a buffer to an aligned stride.
+		static size_t aligned_size(size_t bytes)
+		{
+			return (bytes + alignment - 1) & ~(alignment - 1);
+		}
+
+		/**
+		 *	@brief	Gets a block of at least @c bytes bytes aligned to #alignment.
+		 *	@return	@c NULL if the memory is exhausted
+		 */
+		void* acquire(size_t bytes)
+		{
+			bytes = aligned_size(bytes ? bytes : 1);
+
+			{
+				detail::pool_lock lock(mutex_);
+				free_list::iterator it = free_.find(bytes);
+				if (it != free_.end() && !it->second.empty()) {
+					void* ptr = it->second.back();
+					it->second.pop_back();
+					cached_bytes_ -= bytes;
+					return ptr;
+				}
+			}
+
+			// the header right before the aligned block keeps the raw pointer and the size
+			char* raw = static_cast<char*>(std::malloc(bytes + alignment + sizeof(header)));
+			if (!raw) return NULL;
+
+			char* ptr = reinterpret_cast<char*>((reinterpret_cast<size_t>(raw) + sizeof(header) + alignment - 1) & ~(alignment - 1));
+			header* h = reinterpret_cast<header*>(ptr) - 1;
+			h->raw = raw;
+			h->size = bytes;
+
+			return ptr;
+		}
+
+		/// Returns a block obtained from any pool to the free list of its size, or frees it beyond #limit.
+		void release(void* ptr)
+		{
+			if (!ptr) return;
+
+			header* h = static_cast<header*>(ptr) - 1;
+			{
+				detail::pool_lock lock(mutex_);
+				if (cached_bytes_ + h->size <= limit_) {
+					free_[h->size].push_back(ptr);
+					cached_bytes_ += h->size;
+					return;
+				}
+			}
+			std::free(h->raw);
+		}
+
+		/// Frees the cached blocks.
+		void trim()
+		{
+			detail::pool_lock lock(mutex_);
+			for (free_list::iterator it = free_.begin() ; it != free_.end() ; ++it)
+				for (size_t i = 0 ; i < it->second.size() ; i++)
+					std::free((static_cast<header*>(it->second[i]) - 1)->raw);
+			free_.clear();
+			cached_bytes_ = 0;
+		}
+
+		/// Counts the cached blocks.
+		size_t cached() const
+		{
+			detail::pool_lock lock(mutex_);
+			size_t n = 0;
+			for (free_list::const_iterator it = free_.begin() ; it != free_.end() ; ++it)
+				n += it->second.size();
+			return n;
+		}
+
+		/// Get the maximum number of bytes kept in the free lists
+		inline size_t limit() const { return limit_; }
+
+		/// Sets the maximum number of bytes kept in the free lists; the blocks cached already are kept.
+		inline void limit(size_t bytes) { detail::pool_lock lock(mutex_); limit_ = bytes; }
+
+		/**
+		 *	@brief	Gets the pool of the calling thread.
+		 *	@note	Without @c USE_CXX11 there is a single pool, which is shared by all the threads under its lock.
+		 */
+		static image_pool& local()
+		{
+#ifdef USE_CXX11
+			static thread_local image_pool pool;
+			return pool;
+#else
+			return detail::shared_pool<image_pool>::pool;
+#endif
+		}
+
+	private:
+		image_pool(const image_pool&);
+		image_pool& operator=(const image_pool&);
+
+		/// The bookkeeping of a block
+		struct header
+		{
+			char*	raw;	///< the allocated memory
+			size_t	size;	///< the size of the block
+		};
+
+		typedef std::map<size_t, std::vector<void*> > free_list;
+
+		free_list					free_;			///< the released blocks by size
+		size_t						limit_;			///< the maximum number of bytes in #free_
+		size_t						cached_bytes_;	///< the number of bytes in #free_
+		mutable detail::pool_mutex	mutex_;			///< the lock of #free_
+	};
+}
\ No newline at end of file
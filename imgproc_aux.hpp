@@ -55,6 +55,8 @@
 using namespace arma;
 
 #include "arma_ext.hpp"
+#include "simd_aux.hpp"
+#include "image_pool.hpp"
 
 namespace auxiliary
 {
@@ -79,7 +81,274 @@ namespace auxiliary
 		T& width()          { return this->at(0); }
 		T& height()         { return this->at(1); }
 	};
+
+	/**
+	 *	@brief	Template class for rectangle type
+	 *	@tparam	T	the type of coordinates and size
+	 */
+	template <typename T>
+	class Rect : public arma::Col<T>::template fixed<4>
+	{
+	public:
+
+		Rect(T x = 0, T y = 0, T w = 0, T h = 0)
+		{
+			this->at(0) = x;
+			this->at(1) = y;
+			this->at(2) = w;
+			this->at(3) = h;
+		}
+
+		T x() const         { return this->at(0); }
+		T y() const         { return this->at(1); }
+		T width() const     { return this->at(2); }
+		T height() const    { return this->at(3); }
+
+		T& x()              { return this->at(0); }
+		T& y()              { return this->at(1); }
+		T& width()          { return this->at(2); }
+		T& height()         { return this->at(3); }
+
+		T area() const      { return width() * height(); }
+	};
     
+	namespace detail
+	{
+		/// The number of elements converted by a task of the converting constructor of #Image.
+		const arma::uword convert_block = 1 << 14;
+
+		/// Converts the elements [i, n) with saturation in SSE2; no kernel by default.
+		template <typename T, typename DT>
+		inline arma::uword convert_sse2(const DT*, T*, arma::uword i, arma::uword)
+		{
+			return i;
+		}
+
+		/// Converts the elements [i, n) with saturation in AVX2; no kernel by default.
+		template <typename T, typename DT>
+		inline arma::uword convert_avx2(const DT*, T*, arma::uword i, arma::uword)
+		{
+			return i;
+		}
+
+#if ENABLE_SSE2
+		/**
+		 *	@brief	Rounds 2 doubles to integers with the halves rounded up, as saturate_cast rounds the pixels;
+		 *			@c _mm_cvtpd_epi32 alone rounds them to even. The doubles must be in the range of @c int.
+		 */
+		inline __m128i round_half_up(__m128d x)
+		{
+			const __m128d r = _mm_cvtepi32_pd(_mm_cvtpd_epi32(x));
+			const __m128d tie = _mm_cmpeq_pd(_mm_sub_pd(x, r), _mm_set1_pd(0.5));
+			return _mm_cvtpd_epi32(_mm_add_pd(r, _mm_and_pd(tie, _mm_set1_pd(1.0))));
+		}
+
+		/// Rounds 4 floats to integers with the halves rounded up, clamped so that out of range values saturate instead of wrapping.
+		inline __m128i convert_round(__m128 x)
+		{
+			x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.f)), _mm_set1_ps(65536.f));
+			const __m128i r = _mm_cvtps_epi32(x);
+			// the difference is exact in this range, and a tie rounded down to even is moved up
+			const __m128 tie = _mm_cmpeq_ps(_mm_sub_ps(x, _mm_cvtepi32_ps(r)), _mm_set1_ps(0.5f));
+			return _mm_sub_epi32(r, _mm_castps_si128(tie));
+		}
+
+		/// Rounds 4 doubles to integers with the halves rounded up, clamped so that out of range values saturate instead of wrapping.
+		inline __m128i convert_round(const double* p)
+		{
+			const __m128d lo = _mm_set1_pd(-1.0), hi = _mm_set1_pd(65536.0);
+			const __m128i a = round_half_up(_mm_min_pd(_mm_max_pd(_mm_loadu_pd(p), lo), hi));
+			const __m128i b = round_half_up(_mm_min_pd(_mm_max_pd(_mm_loadu_pd(p + 2), lo), hi));
+			return _mm_unpacklo_epi64(a, b);
+		}
+
+		/// Packs 8 integers into unsigned 16-bit integers with saturation; SSE2 only packs signed ones, hence the bias.
+		inline __m128i convert_packus_epi32(__m128i a, __m128i b)
+		{
+			const __m128i bias = _mm_set1_epi32(32768);
+			return _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias)), _mm_set1_epi16((short)0x8000));
+		}
+
+		inline arma::uword convert_sse2(const float* src, unsigned char* dst, arma::uword i, arma::uword n)
+		{
+			for ( ; i + 16 <= n ; i += 16) {
+				const __m128i a = _mm_packs_epi32(convert_round(_mm_loadu_ps(src + i)), convert_round(_mm_loadu_ps(src + i + 4)));
+				const __m128i b = _mm_packs_epi32(convert_round(_mm_loadu_ps(src + i + 8)), convert_round(_mm_loadu_ps(src + i + 12)));
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+			}
+			return i;
+		}
+
+		inline arma::uword convert_sse2(const float* src, unsigned short* dst, arma::uword i, arma::uword n)
+		{
+			for ( ; i + 8 <= n ; i += 8)
+				_mm_storeu_si128((__m128i*)(dst + i), convert_packus_epi32(convert_round(_mm_loadu_ps(src + i)), convert_round(_mm_loadu_ps(src + i + 4))));
+			return i;
+		}
+
+		inline arma::uword convert_sse2(const double* src, unsigned char* dst, arma::uword i, arma::uword n)
+		{
+			for ( ; i + 16 <= n ; i += 16) {
+				const __m128i a = _mm_packs_epi32(convert_round(src + i), convert_round(src + i + 4));
+				const __m128i b = _mm_packs_epi32(convert_round(src + i + 8), convert_round(src + i + 12));
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+			}
+			return i;
+		}
+
+		inline arma::uword convert_sse2(const double* src, unsigned short* dst, arma::uword i, arma::uword n)
+		{
+			for ( ; i + 8 <= n ; i += 8)
+				_mm_storeu_si128((__m128i*)(dst + i), convert_packus_epi32(convert_round(src + i), convert_round(src + i + 4)));
+			return i;
+		}
+
+		inline arma::uword convert_sse2(const unsigned char* src, float* dst, arma::uword i, arma::uword n)
+		{
+			const __m128i z = _mm_setzero_si128();
+			for ( ; i + 16 <= n ; i += 16) {
+				const __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+				const __m128i lo = _mm_unpacklo_epi8(x, z), hi = _mm_unpackhi_epi8(x, z);
+				_mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, z)));
+				_mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, z)));
+				_mm_storeu_ps(dst + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, z)));
+				_mm_storeu_ps(dst + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, z)));
+			}
+			return i;
+		}
+
+		inline arma::uword convert_sse2(const unsigned short* src, float* dst, arma::uword i, arma::uword n)
+		{
+			const __m128i z = _mm_setzero_si128();
+			for ( ; i + 8 <= n ; i += 8) {
+				const __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+				_mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, z)));
+				_mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(x, z)));
+			}
+			return i;
+		}
+
+		inline arma::uword convert_sse2(const int* src, unsigned char* dst, arma::uword i, arma::uword n)
+		{
+			for ( ; i + 16 <= n ; i += 16) {
+				const __m128i a = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(src + i)), _mm_loadu_si128((const __m128i*)(src + i + 4)));
+				const __m128i b = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(src + i + 8)), _mm_loadu_si128((const __m128i*)(src + i + 12)));
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+			}
+			return i;
+		}
+#endif
+
+#if ENABLE_AVX2
+		/// AVX2 version of #round_half_up.
+		AUX_TARGET_AVX2 inline __m128i round_half_up_avx2(__m256d x)
+		{
+			const __m256d r = _mm256_round_pd(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+			const __m256d tie = _mm256_cmp_pd(_mm256_sub_pd(x, r), _mm256_set1_pd(0.5), _CMP_EQ_OQ);
+			return _mm256_cvtpd_epi32(_mm256_add_pd(r, _mm256_and_pd(tie, _mm256_set1_pd(1.0))));
+		}
+
+		/// AVX2 version of #convert_round.
+		AUX_TARGET_AVX2 inline __m256i convert_round_avx2(__m256 x)
+		{
+			x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-1.f)), _mm256_set1_ps(65536.f));
+			const __m256i r = _mm256_cvtps_epi32(x);
+			const __m256 tie = _mm256_cmp_ps(_mm256_sub_ps(x, _mm256_cvtepi32_ps(r)), _mm256_set1_ps(0.5f), _CMP_EQ_OQ);
+			return _mm256_sub_epi32(r, _mm256_castps_si256(tie));
+		}
+
+		/// Packs 32 integers into bytes with saturation, in order.
+		AUX_TARGET_AVX2 inline __m256i convert_packus_epi8(__m256i a, __m256i b, __m256i c, __m256i d)
+		{
+			// the packs interleave the lanes, the 4-byte groups are a0 b0 c0 d0 a1 b1 c1 d1
+			const __m256i x = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+			return _mm256_permutevar8x32_epi32(x, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+		}
+
+		AUX_TARGET_AVX2 inline arma::uword convert_avx2(const float* src, unsigned char* dst, arma::uword i, arma::uword n)
+		{
+			for ( ; i + 32 <= n ; i += 32)
+				_mm256_storeu_si256((__m256i*)(dst + i), convert_packus_epi8(convert_round_avx2(_mm256_loadu_ps(src + i)), convert_round_avx2(_mm256_loadu_ps(src + i + 8)),
+																			 convert_round_avx2(_mm256_loadu_ps(src + i + 16)), convert_round_avx2(_mm256_loadu_ps(src + i + 24))));
+			return i;
+		}
+
+		AUX_TARGET_AVX2 inline arma::uword convert_avx2(const float* src, unsigned short* dst, arma::uword i, arma::uword n)
+		{
+			for ( ; i + 16 <= n ; i += 16) {
+				const __m256i x = _mm256_packus_epi32(convert_round_avx2(_mm256_loadu_ps(src + i)), convert_round_avx2(_mm256_loadu_ps(src + i + 8)));
+				_mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(x, 0xD8));
+			}
+			return i;
+		}
+
+		AUX_TARGET_AVX2 inline arma::uword convert_avx2(const double* src, unsigned char* dst, arma::uword i, arma::uword n)
+		{
+			const __m256d lo = _mm256_set1_pd(-1.0), hi = _mm256_set1_pd(65536.0);
+			for ( ; i + 16 <= n ; i += 16) {
+				__m128i x[4];
+				for (int k = 0 ; k < 4 ; k++)
+					x[k] = round_half_up_avx2(_mm256_min_pd(_mm256_max_pd(_mm256_loadu_pd(src + i + k * 4), lo), hi));
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_packs_epi32(x[0], x[1]), _mm_packs_epi32(x[2], x[3])));
+			}
+			return i;
+		}
+
+		AUX_TARGET_AVX2 inline arma::uword convert_avx2(const double* src, unsigned short* dst, arma::uword i, arma::uword n)
+		{
+			const __m256d lo = _mm256_set1_pd(-1.0), hi = _mm256_set1_pd(65536.0);
+			for ( ; i + 8 <= n ; i += 8) {
+				const __m128i a = round_half_up_avx2(_mm256_min_pd(_mm256_max_pd(_mm256_loadu_pd(src + i), lo), hi));
+				const __m128i b = round_half_up_avx2(_mm256_min_pd(_mm256_max_pd(_mm256_loadu_pd(src + i + 4), lo), hi));
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi32(a, b));
+			}
+			return i;
+		}
+
+		AUX_TARGET_AVX2 inline arma::uword convert_avx2(const unsigned char* src, float* dst, arma::uword i, arma::uword n)
+		{
+			for ( ; i + 8 <= n ; i += 8)
+				_mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)))));
+			return i;
+		}
+
+		AUX_TARGET_AVX2 inline arma::uword convert_avx2(const unsigned short* src, float* dst, arma::uword i, arma::uword n)
+		{
+			for ( ; i + 8 <= n ; i += 8)
+				_mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)))));
+			return i;
+		}
+
+		AUX_TARGET_AVX2 inline arma::uword convert_avx2(const int* src, unsigned char* dst, arma::uword i, arma::uword n)
+		{
+			for ( ; i + 32 <= n ; i += 32)
+				_mm256_storeu_si256((__m256i*)(dst + i), convert_packus_epi8(_mm256_loadu_si256((const __m256i*)(src + i)), _mm256_loadu_si256((const __m256i*)(src + i + 8)),
+																			 _mm256_loadu_si256((const __m256i*)(src + i + 16)), _mm256_loadu_si256((const __m256i*)(src + i + 24))));
+			return i;
+		}
+#endif
+
+		/**
+		 *	@brief	Converts @c n elements with saturation as arma_ext::saturate_cast does.<br>
+		 *			Floating point elements are rounded to the nearest integer with the halves rounded up, by the SIMD kernels too.
+		 */
+		template <typename T, typename DT>
+		inline void convert(const DT* src, T* dst, arma::uword n)
+		{
+			arma::uword i = 0;
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				i = convert_avx2(src, dst, i, n);
+#endif
+#if ENABLE_SSE2
+			if (simd_support() >= simd_sse2)
+				i = convert_sse2(src, dst, i, n);
+#endif
+			for ( ; i < n ; i++)
+				dst[i] = arma_ext::saturate_cast<T>(src[i]);
+		}
+	}
+
 	//!	A template image class.
 	template <typename T>
 	class Image : public Mat<T>
@@ -98,26 +367,33 @@ namespace auxiliary
 
 		/// Constructor
 		Image(const size_type width, const size_type height) : Mat<T>(height, width) {}
+
+		/// Constructor, uses the auxiliary memory directly unless @c copy_aux_mem is set (see arma::Mat)
+		Image(T* aux_mem, const size_type width, const size_type height, const bool copy_aux_mem = true, const bool strict = false)
+			: Mat<T>(aux_mem, height, width, copy_aux_mem, strict) {}
 		
 		/// Constructor
 		template <typename DT>
 		Image(const Mat<DT>& m): Mat<T>(m.n_rows, m.n_cols)
 		{
 			T* ptr = this->memptr();
-			// type conversion
+			const DT* src = m.memptr();
+			const size_type n_blocks = (m.n_elem + detail::convert_block - 1) / detail::convert_block;
+			// type conversion, vectorized for the common pixel types (see detail::convert)
 #if defined(USE_PPL)
-			concurrency::parallel_for(size_type(0), m.n_elem, [&](size_type i) {
+			concurrency::parallel_for(size_type(0), n_blocks, [&](size_type b) {
 #elif defined(USE_OPENMP)
 	#pragma omp parallel for
-            for (int si = 0 ; si < (int)m.n_elem ; si++) {
-				size_type i = (size_type)si;
+            for (int sb = 0 ; sb < (int)n_blocks ; sb++) {
+				size_type b = (size_type)sb;
 #else
-            for (size_type i = 0 ; i < m.n_elem ; i++)
+            for (size_type b = 0 ; b < n_blocks ; b++) {
 #endif
-				ptr[i] = arma_ext::saturate_cast<T>(m(i));
+				const size_type i = b * detail::convert_block;
+				detail::convert(src + i, ptr + i, std::min(detail::convert_block, m.n_elem - i));
 #if defined(USE_PPL)
 			});
-#elif defined(USE_OPENMP)
+#else
 			}
 #endif
 		}
@@ -145,211 +421,1856 @@ namespace auxiliary
 	};
 
 	/**
-	 *	@brief	Retrieves a pixel rectangle from an image with sub-pixel accuracy.
-	 *	@param img source image
-	 *	@param patchsize	The size of the extracted patch.
-	 *	@param center		The coordinate of the center of the extracted rectangle within the source image.
-	 *						The center must be inside of image.
-	 *	@return	Extracted patch that has the size @c patchsize and the same format as @c img.
-	 *			This function extracts pixels from src:
-	 *			\f[
-	 *				dst(x, y) = src(x + center.x - (dst.cols - 1) * 0.5, y + center.y - (dst.rows - 1) * 0.5)
-	 *			\f]
-	 *			where the values of the pixels at non-integer coordinates are retrieved using bilinear interpolation.
-	 *			While the center of the rectangle must be inside the image, parts of the rectangle may be outside.
-	 *			In this case, extrapolate the pixel values by replication border condition.
+	 *	@brief	An image of which buffer is taken from an #image_pool and returned to it on destruction.<br>
+	 *			The buffer is aligned to image_pool::alignment, and an image of a size seen before is not allocated.
+	 *	@note	The image cannot be resized, and copies of it have their own memory.
 	 */
-	template <typename pixel_type, typename vec_type>
-	static arma::Mat<pixel_type> getRectSubPix(const Image<pixel_type>& img, Size<arma_ext::uword> patchsize, const vec_type center)
+	template <typename T>
+	class pooled_image
 	{
-		typedef typename vec_type::elem_type elem_type;
-		typedef typename arma_ext::size_type size_type;
-		arma::Mat<pixel_type> out(patchsize.height(), patchsize.width());
+	public:
+		typedef typename Image<T>::size_type	size_type;
 
-#ifdef __VXWORKS__
-		typename arma::Col<elem_type>::template fixed<2> center_;
-		center_[0] = center[0];
-		center_[1] = center[1];
-#else
-        typename arma::Col<elem_type>::template fixed<2> center_ = center;
-#endif
+		/// Constructor
+		pooled_image(size_type width, size_type height, image_pool& pool = image_pool::local())
+			: pool_(pool), ptr_(acquire(pool, width * height)), img_(ptr_, width, height, false, true) {}
 
-		center_[0] -= (elem_type)(patchsize.width() - 1) * (elem_type)0.5;
-		center_[1] -= (elem_type)(patchsize.height() - 1) * (elem_type)0.5;
+		/// Destructor
+		~pooled_image() { pool_.release(ptr_); }
 
-		int ipx = (int)std::floor(center_[0]);
-		int ipy = (int)std::floor(center_[1]);
+		/// Gets the image
+		inline Image<T>& get() { return img_; }
 
-		elem_type ox = center_[0] - (elem_type)ipx;
-		elem_type oy = center_[1] - (elem_type)ipy;
-		
-		elem_type a11 = (1 - ox) * (1 - oy),
-				  a12 =      ox  * (1 - oy),
-				  a21 = (1 - ox) * oy,
-				  a22 =      ox  * oy;
-
-		if (0 <= ipx && ipx + patchsize.width() < img.n_cols &&
-			0 <= ipy && ipy + patchsize.height() < img.n_rows) {
-			// extracted rectangle is totally inside the image
-#ifdef USE_PPL
-			concurrency::parallel_for(arma_ext::size_type(0), out.n_cols, [&](arma_ext::size_type j) {
-#elif defined(USE_OPENMP)
-	#pragma omp parallel for
-			for (int sj = 0 ; sj < (int)out.n_cols ; sj++) {
-				size_type j = (size_type)sj;
-#else
-            for (size_type j = 0 ; j < out.n_cols ; j++) {
-#endif
-				pixel_type* ptr = out.colptr(j);
-				const pixel_type* src = img.colptr(ipx + j) + ipy;
-				size_type i;
-				for (i = 0 ; i < out.n_rows ; i++) {
-					// bilinear interpolation
-					ptr[i] = arma_ext::saturate_cast<pixel_type>((elem_type)src[i                 ] * a11 +
-							(elem_type)src[i + 1             ] * a21 +
-							(elem_type)src[i + img.n_rows    ] * a12 +
-							(elem_type)src[i + img.n_rows + 1] * a22);
-				}
-#ifdef USE_PPL
-			});
-#else
-			}
-#endif
-		} else {
-			arma::ivec4 r;
+		/// Gets the image
+		inline const Image<T>& get() const { return img_; }
 
-			// adjust rectangle
-			int sox = 0, soy = 0;
+		inline Image<T>& operator*() { return img_; }
+		inline const Image<T>& operator*() const { return img_; }
+		inline Image<T>* operator->() { return &img_; }
+		inline const Image<T>* operator->() const { return &img_; }
 
-			// -------- begin --------
-			if (ipx >= 0) {
-				sox += ipx;	// + ipx
-				r[0] = 0;
-			} else {
-				r[0] = -ipx;
-				if (r[0] > (int)patchsize.width())
-					r[0] = patchsize.width();
-			}
-			
-			if (ipx + (int)patchsize.width() < (int)img.n_cols)
-				r[2] = patchsize.width();
-			else {
-				r[2] = (int)img.n_cols - ipx - 1;
-				if (r[2] < 0) {
-					sox += r(2);	// + width
-					r[2] = 0;
+	private:
+		pooled_image(const pooled_image&);
+		pooled_image& operator=(const pooled_image&);
+
+		static T* acquire(image_pool& pool, size_type n)
+		{
+			T* ptr = static_cast<T*>(pool.acquire(sizeof(T) * n));
+			if (!ptr) throw std::bad_alloc();
+			return ptr;
+		}
+
+		image_pool&	pool_;	///< the pool of the buffer
+		T*			ptr_;	///< the buffer
+		Image<T>	img_;	///< the image on the buffer
+	};
+
+	/// The memory layouts of an #image_view
+	enum image_layout
+	{
+		col_major,	///< the pixels of a column are contiguous, as in Image
+		row_major	///< the pixels of a row are contiguous, as in cv::Mat and most frame buffers
+	};
+
+	/**
+	 *	@brief	A non-owning image on external memory such as a camera or decoder frame buffer.<br>
+	 *			The columns (or the rows for ::row_major) are @c stride elements apart, so padded buffers are viewed without copy.
+	 *	@note	The memory must outlive the view. A ::col_major view has the interface of arma::Mat used by
+	 *			the image processing templates (@c n_rows, @c n_cols, @c colptr), and #integral, #pyrDown,
+	 *			#getRectSubPix and #blur have overloads which also take ::row_major views.
+	 */
+	template <typename T>
+	class image_view
+	{
+	public:
+		typedef T				elem_type;	///< the type of pixels
+		typedef arma::uword		size_type;
+
+		const size_type n_rows;	///< the height
+		const size_type n_cols;	///< the width
+		const size_type n_elem;	///< the number of pixels
+
+		/**
+		 *	@brief	Constructor
+		 *	@param data		the first pixel
+		 *	@param stride	the distance between two columns (or rows for ::row_major) in elements, 0 if they are contiguous
+		 */
+		image_view(T* data, size_type width, size_type height, size_type stride = 0, image_layout layout = col_major)
+			: n_rows(height), n_cols(width), n_elem(width * height), data_(data),
+			  stride_(stride ? stride : (layout == col_major ? height : width)), layout_(layout)
+		{
+			assert(stride_ >= (layout == col_major ? height : width));
+		}
+
+		/// Constructor, views a matrix
+		image_view(arma::Mat<T>& m)
+			: n_rows(m.n_rows), n_cols(m.n_cols), n_elem(m.n_elem), data_(m.memptr()), stride_(m.n_rows), layout_(col_major) {}
+
+		/// Get image width
+		inline size_type width() const { return n_cols; }
+
+		/// Get image height
+		inline size_type height() const { return n_rows; }
+
+		/// Get the distance between two columns (or rows for ::row_major) in elements
+		inline size_type stride() const { return stride_; }
+
+		/// Get the memory layout
+		inline image_layout layout() const { return layout_; }
+
+		/// Get the first pixel
+		inline T* memptr() { return data_; }
+		inline const T* memptr() const { return data_; }
+
+		/// Get a column of a ::col_major view
+		inline T* colptr(size_type x) { assert(layout_ == col_major); return data_ + x * stride_; }
+		inline const T* colptr(size_type x) const { assert(layout_ == col_major); return data_ + x * stride_; }
+
+		/// Get a pixel
+		inline T& at(size_type y, size_type x) { return data_[layout_ == col_major ? x * stride_ + y : y * stride_ + x]; }
+		inline const T& at(size_type y, size_type x) const { return data_[layout_ == col_major ? x * stride_ + y : y * stride_ + x]; }
+
+		inline T& operator()(size_type y, size_type x) { return at(y, x); }
+		inline const T& operator()(size_type y, size_type x) const { return at(y, x); }
+
+		/// Get the transposed view on the same memory, a ::row_major view becomes a ::col_major one and vice versa.
+		inline image_view t() const
+		{
+			return image_view(data_, n_rows, n_cols, stride_, layout_ == col_major ? row_major : col_major);
+		}
+
+	private:
+		T*				data_;		///< the first pixel
+		size_type		stride_;	///< the distance between two columns or rows
+		image_layout	layout_;	///< the memory layout
+	};
+
+	namespace detail
+	{
+		/// The size of the square tiles of #transpose_copy.
+		const arma::uword transpose_tile = 32;
+
+		/// Transposes a tile of #transpose_tile x #transpose_tile; no vectorized kernel by default.
+		template <typename T1, typename T2>
+		inline bool transpose_tile_simd(const T1*, arma::uword, T2*, arma::uword)
+		{
+			return false;
+		}
+
+#if ENABLE_SSE2
+		/// Transposes a block of 16 x 16 bytes; interleaving the rows i and i + 8 four times transposes the block.
+		inline void transpose16x16_sse2(const unsigned char* src, arma::uword src_stride, unsigned char* dst, arma::uword dst_stride)
+		{
+			__m128i a[16], b[16];
+			for (int i = 0 ; i < 16 ; i++)
+				a[i] = _mm_loadu_si128((const __m128i*)(src + i * src_stride));
+
+			for (int k = 0 ; k < 4 ; k++) {
+				for (int i = 0 ; i < 8 ; i++) {
+					b[i * 2] = _mm_unpacklo_epi8(a[i], a[i + 8]);
+					b[i * 2 + 1] = _mm_unpackhi_epi8(a[i], a[i + 8]);
 				}
+				for (int i = 0 ; i < 16 ; i++)
+					a[i] = b[i];
 			}
 
-			if (ipy >= 0) {
-				soy += ipy;	// + ipy
-				r[1] = 0;
-			} else {
-				r[1] = -ipy;
-				if (r[1] > (int)patchsize.height())
-					r[1] = patchsize.height();
-			}
-
-			if (ipy + (int)patchsize.height() < (int)img.n_rows)
-				r[3] = patchsize.height();
-			else {
-				r[3] = (int)img.n_rows - ipy - 1;
-				if (r[3] < 0) {
-					soy += r[3];	// + height
-					r[3] = 0;
+			for (int i = 0 ; i < 16 ; i++)
+				_mm_storeu_si128((__m128i*)(dst + i * dst_stride), a[i]);
+		}
+
+		/// Transposes a block of 8 x 8 16-bit elements; interleaving the rows i and i + 4 three times transposes the block.
+		inline void transpose8x8_sse2(const unsigned short* src, arma::uword src_stride, unsigned short* dst, arma::uword dst_stride)
+		{
+			__m128i a[8], b[8];
+			for (int i = 0 ; i < 8 ; i++)
+				a[i] = _mm_loadu_si128((const __m128i*)(src + i * src_stride));
+
+			for (int k = 0 ; k < 3 ; k++) {
+				for (int i = 0 ; i < 4 ; i++) {
+					b[i * 2] = _mm_unpacklo_epi16(a[i], a[i + 4]);
+					b[i * 2 + 1] = _mm_unpackhi_epi16(a[i], a[i + 4]);
 				}
+				for (int i = 0 ; i < 8 ; i++)
+					a[i] = b[i];
 			}
-			// --------- end ---------
 
-			//soy -= r(1);
+			for (int i = 0 ; i < 8 ; i++)
+				_mm_storeu_si128((__m128i*)(dst + i * dst_stride), a[i]);
+		}
+
+		/// Transposes a tile of 8-bit pixels in blocks of 16 x 16.
+		inline bool transpose_tile_simd(const unsigned char* src, arma::uword src_stride, unsigned char* dst, arma::uword dst_stride)
+		{
+			if (simd_support() < simd_sse2) return false;
+
+			for (arma::uword y = 0 ; y < transpose_tile ; y += 16)
+				for (arma::uword x = 0 ; x < transpose_tile ; x += 16)
+					transpose16x16_sse2(src + x * src_stride + y, src_stride, dst + y * dst_stride + x, dst_stride);
+			return true;
+		}
 
-			elem_type b1 = (elem_type)1.0 - ox,
-					  b2 = ox;
+		/// Transposes a tile of 16-bit pixels in blocks of 8 x 8.
+		inline bool transpose_tile_simd(const unsigned short* src, arma::uword src_stride, unsigned short* dst, arma::uword dst_stride)
+		{
+			if (simd_support() < simd_sse2) return false;
 
-			const pixel_type* src1 = img.colptr(sox) + soy;
-			for (size_type j = 0 ; j < out.n_cols ; j++) {
-				pixel_type* ptr = out.colptr(j);
-				const pixel_type* src2 = src1 + img.n_rows;
+			for (arma::uword y = 0 ; y < transpose_tile ; y += 8)
+				for (arma::uword x = 0 ; x < transpose_tile ; x += 8)
+					transpose8x8_sse2(src + x * src_stride + y, src_stride, dst + y * dst_stride + x, dst_stride);
+			return true;
+		}
+#endif
 
-				if ((int)j < r[0] || (int)j >= r[2])
-					src2 -= img.n_rows;
-								
-				size_type i = 0;
-				for (; i < (size_type)r(1) ; i++)
-					ptr[i] = arma_ext::saturate_cast<pixel_type>((elem_type)src1[r[1]] * b1 + (elem_type)src2[r[1]] * b2);
+		/**
+		 *	@brief	Copies the transpose of a column-major block of @c n_rows x @c n_cols into @c dst, dst(x, y) = src(y, x).<br>
+		 *			The block is copied tile by tile so that both sides stay in cache, and the full tiles of
+		 *			8-bit and 16-bit pixels are transposed in SSE2 registers.
+		 *	@param src_stride, dst_stride	the distances between two columns of @c src and @c dst
+		 */
+		template <typename T1, typename T2>
+		void transpose_copy(const T1* src, arma::uword src_stride, T2* dst, arma::uword dst_stride, arma::uword n_rows, arma::uword n_cols)
+		{
+			for (arma::uword y0 = 0 ; y0 < n_rows ; y0 += transpose_tile) {
+				const arma::uword y1 = std::min(y0 + transpose_tile, n_rows);
+				for (arma::uword x0 = 0 ; x0 < n_cols ; x0 += transpose_tile) {
+					const arma::uword x1 = std::min(x0 + transpose_tile, n_cols);
+					if (y1 - y0 == transpose_tile && x1 - x0 == transpose_tile &&
+						transpose_tile_simd(src + x0 * src_stride + y0, src_stride, dst + y0 * dst_stride + x0, dst_stride))
+						continue;
 
-				for ( ; i < (size_type)r(3) ; i++) {
-					// bilinear interpolation
-					ptr[i] = arma_ext::saturate_cast<pixel_type>((elem_type)src1[i    ] * a11 +
-							(elem_type)src1[i + 1] * a21 +
-							(elem_type)src2[i    ] * a12 +
-							(elem_type)src2[i + 1] * a22);
+					for (arma::uword y = y0 ; y < y1 ; y++) {
+						T2* dptr = dst + y * dst_stride;
+						for (arma::uword x = x0 ; x < x1 ; x++)
+							dptr[x] = (T2)src[x * src_stride + y];
+					}
 				}
+			}
+		}
+
+		/**
+		 *	@brief	#transpose_copy in parallel bands of rows of @c src if enabled.
+		 */
+		template <typename T1, typename T2>
+		void transpose_copy_parallel(const T1* src, arma::uword src_stride, T2* dst, arma::uword dst_stride, arma::uword n_rows, arma::uword n_cols)
+		{
+			const arma::uword band = transpose_tile * 4;
+			const arma::uword n_bands = (n_rows + band - 1) / band;
+#if defined(USE_PPL)
+			concurrency::parallel_for(arma::uword(0), n_bands, [&](arma::uword b) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+			for (int sb = 0 ; sb < (int)n_bands ; sb++) {
+				arma::uword b = (arma::uword)sb;
+#else
+			for (arma::uword b = 0 ; b < n_bands ; b++) {
+#endif
+				const arma::uword y0 = b * band;
+				transpose_copy(src + y0, src_stride, dst + y0 * dst_stride, dst_stride, std::min(band, n_rows - y0), n_cols);
+#if defined(USE_PPL)
+			});
+#else
+			}
+#endif
+		}
 
-				for ( ; i < out.n_rows ; i++)
-					ptr[i] = arma_ext::saturate_cast<pixel_type>((elem_type)src1[r[3]] * b1 + (elem_type)src2[r[3]] * b2);
+		/// Views a matrix or a view as a view.
+		template <typename T>
+		inline image_view<T> as_view(arma::Mat<T>& m) { return image_view<T>(m); }
+		template <typename T>
+		inline image_view<T> as_view(const image_view<T>& v) { return v; }
 
-				if ((int)j < r[2])
-					src1 = src2;
+		/// Views an image as a ::col_major view, transposing a ::row_major one.
+		template <typename T>
+		inline image_view<T> col_major_view(const image_view<T>& v) { return v.layout() == col_major ? v : v.t(); }
+
+		/// Views a read-only view as a mutable one, for the algorithms which only read their source.
+		template <typename T>
+		inline image_view<T> mutable_view(const image_view<const T>& v)
+		{
+			return image_view<T>(const_cast<T*>(v.memptr()), v.width(), v.height(), v.stride(), v.layout());
+		}
+
+		/// Converts the column @c x of an image into @c dst.
+		template <typename T, typename W>
+		inline void load_column(const arma::Mat<T>& img, arma::uword x, W* dst)
+		{
+			const T* src = img.colptr(x);
+			for (arma::uword y = 0 ; y < img.n_rows ; y++)
+				dst[y] = (W)src[y];
+		}
+
+		/// Converts the column @c x of a view into @c dst, gathering it from the rows of a ::row_major view.
+		template <typename T, typename W>
+		inline void load_column(const image_view<T>& img, arma::uword x, W* dst)
+		{
+			if (img.layout() == col_major) {
+				const T* src = img.colptr(x);
+				for (arma::uword y = 0 ; y < img.n_rows ; y++)
+					dst[y] = (W)src[y];
+			} else {
+				const T* src = img.memptr() + x;
+				for (arma::uword y = 0 ; y < img.n_rows ; y++)
+					dst[y] = (W)src[y * img.stride()];
 			}
 		}
-                                      
-		return out;
 	}
-		
+
 	/**
-	 *	@brief	Gaussian blur with given blur kernel.
-	 *	@param	img		An input image.
-	 *	@param	h		The blur kernel.
-	 *	@return	The blurred image.
+	 *	@brief	Selects the arithmetic of the bilinear interpolation for a pixel type.<br>
+	 *			8-bit and 16-bit pixels are interpolated in fixed point with weights of @c bits fractional bits,
+	 *			which is vectorized in 16-bit lanes; other pixels are interpolated in floating point.
+	 *	@note	Compared to the floating point interpolation, the results differ by at most 1 for 8-bit pixels
+	 *			and at most 8 (about 2^-13 of the range) for 16-bit pixels.
+	 *			Specialize this class with @c fixed_point = false to keep the floating point interpolation.
 	 */
-    template <typename pixel_type>
-	inline Image<pixel_type> blur(const Image<pixel_type>& img, const mat& h)
+	template <typename pixel_type>
+	struct interpolation_traits
 	{
-		typedef typename Image<pixel_type>::size_type size_type;
-		return Image<pixel_type>(arma_ext::conv2(conv_to<mat>::from(img), h, arma_ext::same).eval());
-	}
+		static const bool fixed_point = false;	///< whether to interpolate in fixed point
+		static const int bits = 0;				///< the fractional bits of the weights
+	};
 
-#ifdef USE_OPENCV
-	//!	Convert Image type to the cv::Mat type.
-    template <typename pixel_type>
-	cv::Mat tocvMat(const Image<pixel_type>& img)
+	/// 8-bit pixels are interpolated with 11-bit weights as INTER_RESIZE_COEF_BITS of OpenCV.
+	template <>
+	struct interpolation_traits<unsigned char>
 	{
-		cv::Mat out(img.n_rows, img.n_cols, cv::DataType<pixel_type>::type); //!
-        Image<pixel_type> t = img.t().eval();
-		memcpy(out.data, t.memptr(), sizeof(pixel_type) * t.n_elem);
+		static const bool fixed_point = true;
+		static const int bits = 11;
+	};
 
-		//cv::imshow(name, out);
-		return out;
-	}
+	/// 16-bit pixels are interpolated with 14-bit weights, the most that keeps the sums in 32 bits.
+	template <>
+	struct interpolation_traits<unsigned short>
+	{
+		static const bool fixed_point = true;
+		static const int bits = 14;
+	};
 
-	/**
-	 *	@brief	Convert BGR image or colormap to grayscale.
-	 *	@param img	the truecolor BGR image to be converted into grayscale
-	 *	@return	grayscale intensity image
-	 *	@see	http://www.mathworks.co.kr/kr/help/images/ref/rgb2gray.html
-	 */
-    template <typename pixel_type>
-	Image<pixel_type>	bgr2gray(const cv::Mat& img)
+	namespace detail
 	{
-		arma::Mat<pixel_type> gray(img.cols, img.rows);
-		pixel_type* ptr = gray.memptr();
-#if 0
-		concurrency::parallel_for(0, img.rows, [&](int r) {
-		//for (int r = 0 ; r < img.rows ; r++) {
-			const uchar* src = img.ptr(r);
-			uchar* dst = ptr + gray.n_rows * r;
-			for (int c = 0 ; c < img.cols ; c++, src += 3)
-				dst[c] = arma_ext::round<uchar>(src[2] * 0.298936021293776 + src[1] * 0.587043074451121 + src[0] * 0.114020904255103);
-		//}
-		});
-#else
-		cv::Mat bw;
-		cv::cvtColor(img, bw, CV_BGR2GRAY);
-		memcpy(ptr, bw.data, sizeof(pixel_type) * bw.total());
-#endif
+		/// Bilinear interpolation of the rows [i, n) between two columns; no vectorized kernel by default.
+		template <typename pixel_type, typename elem_type>
+		inline arma::uword rect_sub_pix_simd(const pixel_type*, const pixel_type*, pixel_type*, arma::uword i, arma::uword,
+											 elem_type, elem_type, elem_type, elem_type)
+		{
+			return i;
+		}
 
-		return Image<pixel_type>(gray.t());
+#if ENABLE_SSE2
+		/// Loads 4 pixels as doubles.
+		inline void rsp_load4(const unsigned char* p, __m128d& lo, __m128d& hi)
+		{
+			int v;
+			memcpy(&v, p, sizeof(v));
+			const __m128i z = _mm_setzero_si128();
+			const __m128i x = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), z), z);
+			lo = _mm_cvtepi32_pd(x);
+			hi = _mm_cvtepi32_pd(_mm_srli_si128(x, 8));
+		}
+
+		/// Loads 4 pixels as doubles.
+		inline void rsp_load4(const unsigned short* p, __m128d& lo, __m128d& hi)
+		{
+			const __m128i x = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+			lo = _mm_cvtepi32_pd(x);
+			hi = _mm_cvtepi32_pd(_mm_srli_si128(x, 8));
+		}
+
+		/// Loads 4 pixels as doubles.
+		inline void rsp_load4(const float* p, __m128d& lo, __m128d& hi)
+		{
+			const __m128 x = _mm_loadu_ps(p);
+			lo = _mm_cvtps_pd(x);
+			hi = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+		}
+
+		/// Rounds and stores 4 pixels like saturate_cast.
+		inline void rsp_store4(unsigned char* p, __m128d lo, __m128d hi)
+		{
+			__m128i x = _mm_unpacklo_epi64(round_half_up(lo), round_half_up(hi));
+			x = _mm_packs_epi32(x, x);
+			const int v = _mm_cvtsi128_si32(_mm_packus_epi16(x, x));
+			memcpy(p, &v, sizeof(v));
+		}
+
+		/// Rounds and stores 4 pixels, which are in the range of the pixel type.
+		inline void rsp_store4(unsigned short* p, __m128d lo, __m128d hi)
+		{
+			// SSE2 lacks an unsigned 32-bit pack, so bias into the signed range
+			const __m128i bias = _mm_set1_epi32(32768);
+			__m128i x = _mm_unpacklo_epi64(round_half_up(lo), round_half_up(hi));
+			x = _mm_packs_epi32(_mm_sub_epi32(x, bias), _mm_sub_epi32(x, bias));
+			_mm_storel_epi64((__m128i*)p, _mm_xor_si128(x, _mm_set1_epi16((short)0x8000)));
+		}
+
+		/// Stores 4 pixels.
+		inline void rsp_store4(float* p, __m128d lo, __m128d hi)
+		{
+			_mm_storeu_ps(p, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+		}
+
+		/// SSE2 bilinear interpolation of the rows [i, n), which evaluates the same expression as the scalar code.
+		template <typename pixel_type>
+		inline arma::uword rect_sub_pix_sse2(const pixel_type* src1, const pixel_type* src2, pixel_type* dst, arma::uword i, arma::uword n,
+											 double a11, double a12, double a21, double a22)
+		{
+			const __m128d w11 = _mm_set1_pd(a11), w12 = _mm_set1_pd(a12),
+						  w21 = _mm_set1_pd(a21), w22 = _mm_set1_pd(a22);
+
+			for ( ; i + 4 <= n ; i += 4) {
+				__m128d s0[2], s1[2], t0[2], t1[2], v[2];
+				rsp_load4(src1 + i, s0[0], s0[1]);
+				rsp_load4(src1 + i + 1, s1[0], s1[1]);
+				rsp_load4(src2 + i, t0[0], t0[1]);
+				rsp_load4(src2 + i + 1, t1[0], t1[1]);
+				for (int k = 0 ; k < 2 ; k++) {
+					v[k] = _mm_add_pd(_mm_mul_pd(s0[k], w11), _mm_mul_pd(s1[k], w21));
+					v[k] = _mm_add_pd(v[k], _mm_mul_pd(t0[k], w12));
+					v[k] = _mm_add_pd(v[k], _mm_mul_pd(t1[k], w22));
+				}
+				rsp_store4(dst + i, v[0], v[1]);
+			}
+
+			return i;
+		}
+#endif
+
+#if ENABLE_AVX2
+		/// Loads 4 pixels as doubles.
+		AUX_TARGET_AVX2 inline __m256d rsp_load4_avx2(const unsigned char* p)
+		{
+			int v;
+			memcpy(&v, p, sizeof(v));
+			return _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(v)));
+		}
+
+		/// Loads 4 pixels as doubles.
+		AUX_TARGET_AVX2 inline __m256d rsp_load4_avx2(const unsigned short* p)
+		{
+			return _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)p)));
+		}
+
+		/// Loads 4 pixels as doubles.
+		AUX_TARGET_AVX2 inline __m256d rsp_load4_avx2(const float* p)
+		{
+			return _mm256_cvtps_pd(_mm_loadu_ps(p));
+		}
+
+		/// Rounds and stores 4 pixels like saturate_cast.
+		AUX_TARGET_AVX2 inline void rsp_store4_avx2(unsigned char* p, __m256d v)
+		{
+			__m128i x = round_half_up_avx2(v);
+			x = _mm_packs_epi32(x, x);
+			const int r = _mm_cvtsi128_si32(_mm_packus_epi16(x, x));
+			memcpy(p, &r, sizeof(r));
+		}
+
+		/// Rounds and stores 4 pixels like saturate_cast.
+		AUX_TARGET_AVX2 inline void rsp_store4_avx2(unsigned short* p, __m256d v)
+		{
+			const __m128i x = round_half_up_avx2(v);
+			_mm_storel_epi64((__m128i*)p, _mm_packus_epi32(x, x));
+		}
+
+		/// Stores 4 pixels.
+		AUX_TARGET_AVX2 inline void rsp_store4_avx2(float* p, __m256d v)
+		{
+			_mm_storeu_ps(p, _mm256_cvtpd_ps(v));
+		}
+
+		/// AVX2 version of #rect_sub_pix_sse2.
+		template <typename pixel_type>
+		AUX_TARGET_AVX2 inline arma::uword rect_sub_pix_avx2(const pixel_type* src1, const pixel_type* src2, pixel_type* dst, arma::uword i, arma::uword n,
+															 double a11, double a12, double a21, double a22)
+		{
+			const __m256d w11 = _mm256_set1_pd(a11), w12 = _mm256_set1_pd(a12),
+						  w21 = _mm256_set1_pd(a21), w22 = _mm256_set1_pd(a22);
+
+			for ( ; i + 4 <= n ; i += 4) {
+				__m256d v = _mm256_add_pd(_mm256_mul_pd(rsp_load4_avx2(src1 + i), w11), _mm256_mul_pd(rsp_load4_avx2(src1 + i + 1), w21));
+				v = _mm256_add_pd(v, _mm256_mul_pd(rsp_load4_avx2(src2 + i), w12));
+				v = _mm256_add_pd(v, _mm256_mul_pd(rsp_load4_avx2(src2 + i + 1), w22));
+				rsp_store4_avx2(dst + i, v);
+			}
+
+			return i;
+		}
+#endif
+
+#if ENABLE_SSE2
+		/// Dispatches the bilinear interpolation of 8-bit pixels.
+		inline arma::uword rect_sub_pix_simd(const unsigned char* src1, const unsigned char* src2, unsigned char* dst, arma::uword i, arma::uword n,
+											 double a11, double a12, double a21, double a22)
+		{
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				return rect_sub_pix_avx2(src1, src2, dst, i, n, a11, a12, a21, a22);
+#endif
+			return (simd_support() >= simd_sse2) ? rect_sub_pix_sse2(src1, src2, dst, i, n, a11, a12, a21, a22) : i;
+		}
+
+		/// Dispatches the bilinear interpolation of 16-bit pixels.
+		inline arma::uword rect_sub_pix_simd(const unsigned short* src1, const unsigned short* src2, unsigned short* dst, arma::uword i, arma::uword n,
+											 double a11, double a12, double a21, double a22)
+		{
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				return rect_sub_pix_avx2(src1, src2, dst, i, n, a11, a12, a21, a22);
+#endif
+			return (simd_support() >= simd_sse2) ? rect_sub_pix_sse2(src1, src2, dst, i, n, a11, a12, a21, a22) : i;
+		}
+
+		/// Dispatches the bilinear interpolation of single precision pixels.
+		inline arma::uword rect_sub_pix_simd(const float* src1, const float* src2, float* dst, arma::uword i, arma::uword n,
+											 double a11, double a12, double a21, double a22)
+		{
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				return rect_sub_pix_avx2(src1, src2, dst, i, n, a11, a12, a21, a22);
+#endif
+			return (simd_support() >= simd_sse2) ? rect_sub_pix_sse2(src1, src2, dst, i, n, a11, a12, a21, a22) : i;
+		}
+#endif
+
+		/**
+		 *	@brief	Bilinear interpolation of @c n rows between two adjacent columns.
+		 *	@param src1	the left column, from which @c n + 1 pixels are read
+		 *	@param src2	the right column, from which @c n + 1 pixels are read
+		 */
+		template <typename pixel_type, typename elem_type>
+		inline void rect_sub_pix_column(const pixel_type* src1, const pixel_type* src2, pixel_type* dst, arma::uword n,
+										elem_type a11, elem_type a12, elem_type a21, elem_type a22)
+		{
+			arma::uword i = rect_sub_pix_simd(src1, src2, dst, 0, n, a11, a12, a21, a22);
+
+			for ( ; i < n ; i++) {
+				// bilinear interpolation
+				dst[i] = arma_ext::saturate_cast<pixel_type>((elem_type)src1[i    ] * a11 +
+						(elem_type)src1[i + 1] * a21 +
+						(elem_type)src2[i    ] * a12 +
+						(elem_type)src2[i + 1] * a22);
+			}
+		}
+
+		/// Fixed point bilinear interpolation of the rows [i, n) between two columns; no vectorized kernel by default.
+		template <typename pixel_type>
+		inline arma::uword rect_sub_pix_fixed_simd(const pixel_type*, const pixel_type*, pixel_type*, arma::uword i, arma::uword,
+												   int, int, int, int, int)
+		{
+			return i;
+		}
+
+#if ENABLE_SSE2
+		/// Packs two 16-bit weights into the pairs multiplied by _mm_madd_epi16.
+		inline int rsp_weight_pair(int lo, int hi)
+		{
+			return (int)(((unsigned)hi << 16) | ((unsigned)lo & 0xFFFF));
+		}
+
+		/// Loads 8 pixels as 16-bit integers, 16-bit pixels are biased into the signed range.
+		inline __m128i rsp_load8(const unsigned char* p)
+		{
+			return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+		}
+
+		/// Loads 8 pixels as 16-bit integers, 16-bit pixels are biased into the signed range.
+		inline __m128i rsp_load8(const unsigned short* p)
+		{
+			return _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi16((short)0x8000));
+		}
+
+		/// Stores 8 pixels, which are saturated.
+		inline void rsp_store8(unsigned char* p, __m128i lo, __m128i hi)
+		{
+			const __m128i x = _mm_packs_epi32(lo, hi);
+			_mm_storel_epi64((__m128i*)p, _mm_packus_epi16(x, x));
+		}
+
+		/// Stores 8 pixels, which are saturated.
+		inline void rsp_store8(unsigned short* p, __m128i lo, __m128i hi)
+		{
+			// SSE2 lacks an unsigned 32-bit pack, so bias into the signed range
+			const __m128i bias = _mm_set1_epi32(32768);
+			const __m128i x = _mm_packs_epi32(_mm_sub_epi32(lo, bias), _mm_sub_epi32(hi, bias));
+			_mm_storeu_si128((__m128i*)p, _mm_xor_si128(x, _mm_set1_epi16((short)0x8000)));
+		}
+
+		/**
+		 *	@brief	SSE2 fixed point bilinear interpolation of the rows [i, n).
+		 *			The pixels of two adjacent rows are interleaved, so that _mm_madd_epi16 applies two weights at once.
+		 */
+		template <typename pixel_type>
+		inline arma::uword rect_sub_pix_fixed_sse2(const pixel_type* src1, const pixel_type* src2, pixel_type* dst, arma::uword i, arma::uword n,
+												   int a11, int a12, int a21, int a22, int bits)
+		{
+			const __m128i w1 = _mm_set1_epi32(rsp_weight_pair(a11, a21)),
+						  w2 = _mm_set1_epi32(rsp_weight_pair(a12, a22));
+			// the rounding, and the bias of 16-bit pixels multiplied by the sum of the weights
+			const int bias = (sizeof(pixel_type) == 2) ? (32768 << bits) : 0;
+			const __m128i delta = _mm_set1_epi32(bias + (1 << (bits - 1)));
+			const __m128i shift = _mm_cvtsi32_si128(bits);
+
+			for ( ; i + 8 <= n ; i += 8) {
+				const __m128i s0 = rsp_load8(src1 + i), s1 = rsp_load8(src1 + i + 1),
+							  t0 = rsp_load8(src2 + i), t1 = rsp_load8(src2 + i + 1);
+				__m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(s0, s1), w1), _mm_madd_epi16(_mm_unpacklo_epi16(t0, t1), w2));
+				__m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(s0, s1), w1), _mm_madd_epi16(_mm_unpackhi_epi16(t0, t1), w2));
+				lo = _mm_sra_epi32(_mm_add_epi32(lo, delta), shift);
+				hi = _mm_sra_epi32(_mm_add_epi32(hi, delta), shift);
+				rsp_store8(dst + i, lo, hi);
+			}
+
+			return i;
+		}
+#endif
+
+#if ENABLE_AVX2
+		/// Loads 16 pixels as 16-bit integers, 16-bit pixels are biased into the signed range.
+		AUX_TARGET_AVX2 inline __m256i rsp_load16(const unsigned char* p)
+		{
+			return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+		}
+
+		/// Loads 16 pixels as 16-bit integers, 16-bit pixels are biased into the signed range.
+		AUX_TARGET_AVX2 inline __m256i rsp_load16(const unsigned short* p)
+		{
+			return _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)p), _mm256_set1_epi16((short)0x8000));
+		}
+
+		/// Stores 16 pixels, which are saturated; the unpacked halves are in the order of the 128-bit lanes.
+		AUX_TARGET_AVX2 inline void rsp_store16(unsigned char* p, __m256i lo, __m256i hi)
+		{
+			const __m256i x = _mm256_packs_epi32(lo, hi);
+			const __m256i y = _mm256_permute4x64_epi64(_mm256_packus_epi16(x, x), 0xD8);
+			_mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(y));
+		}
+
+		/// Stores 16 pixels, which are saturated; the unpacked halves are in the order of the 128-bit lanes.
+		AUX_TARGET_AVX2 inline void rsp_store16(unsigned short* p, __m256i lo, __m256i hi)
+		{
+			_mm256_storeu_si256((__m256i*)p, _mm256_packus_epi32(lo, hi));
+		}
+
+		/// AVX2 version of #rect_sub_pix_fixed_sse2.
+		template <typename pixel_type>
+		AUX_TARGET_AVX2 inline arma::uword rect_sub_pix_fixed_avx2(const pixel_type* src1, const pixel_type* src2, pixel_type* dst, arma::uword i, arma::uword n,
+																   int a11, int a12, int a21, int a22, int bits)
+		{
+			const __m256i w1 = _mm256_set1_epi32(rsp_weight_pair(a11, a21)),
+						  w2 = _mm256_set1_epi32(rsp_weight_pair(a12, a22));
+			const int bias = (sizeof(pixel_type) == 2) ? (32768 << bits) : 0;
+			const __m256i delta = _mm256_set1_epi32(bias + (1 << (bits - 1)));
+			const __m128i shift = _mm_cvtsi32_si128(bits);
+
+			for ( ; i + 16 <= n ; i += 16) {
+				const __m256i s0 = rsp_load16(src1 + i), s1 = rsp_load16(src1 + i + 1),
+							  t0 = rsp_load16(src2 + i), t1 = rsp_load16(src2 + i + 1);
+				__m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(s0, s1), w1), _mm256_madd_epi16(_mm256_unpacklo_epi16(t0, t1), w2));
+				__m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(s0, s1), w1), _mm256_madd_epi16(_mm256_unpackhi_epi16(t0, t1), w2));
+				lo = _mm256_sra_epi32(_mm256_add_epi32(lo, delta), shift);
+				hi = _mm256_sra_epi32(_mm256_add_epi32(hi, delta), shift);
+				rsp_store16(dst + i, lo, hi);
+			}
+
+			return i;
+		}
+#endif
+
+#if ENABLE_SSE2
+		/// Dispatches the fixed point bilinear interpolation of 8-bit pixels.
+		inline arma::uword rect_sub_pix_fixed_simd(const unsigned char* src1, const unsigned char* src2, unsigned char* dst, arma::uword i, arma::uword n,
+												   int a11, int a12, int a21, int a22, int bits)
+		{
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				i = rect_sub_pix_fixed_avx2(src1, src2, dst, i, n, a11, a12, a21, a22, bits);
+#endif
+			return (simd_support() >= simd_sse2) ? rect_sub_pix_fixed_sse2(src1, src2, dst, i, n, a11, a12, a21, a22, bits) : i;
+		}
+
+		/// Dispatches the fixed point bilinear interpolation of 16-bit pixels.
+		inline arma::uword rect_sub_pix_fixed_simd(const unsigned short* src1, const unsigned short* src2, unsigned short* dst, arma::uword i, arma::uword n,
+												   int a11, int a12, int a21, int a22, int bits)
+		{
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				i = rect_sub_pix_fixed_avx2(src1, src2, dst, i, n, a11, a12, a21, a22, bits);
+#endif
+			return (simd_support() >= simd_sse2) ? rect_sub_pix_fixed_sse2(src1, src2, dst, i, n, a11, a12, a21, a22, bits) : i;
+		}
+#endif
+
+		/**
+		 *	@brief	Bilinear weights of #rect_sub_pix in floating point.
+		 */
+		template <typename pixel_type, typename elem_type, bool fixed_point = interpolation_traits<pixel_type>::fixed_point>
+		struct bilinear_weights
+		{
+			elem_type a11, a12, a21, a22;	///< the weights of the four neighbors
+			elem_type b1, b2;				///< the weights of the two horizontal neighbors
+
+			bilinear_weights(elem_type ox, elem_type oy)
+				: a11((1 - ox) * (1 - oy)), a12(ox * (1 - oy)), a21((1 - ox) * oy), a22(ox * oy), b1((elem_type)1.0 - ox), b2(ox) {}
+
+			/// Interpolates @c n rows between two adjacent columns.
+			inline void column(const pixel_type* src1, const pixel_type* src2, pixel_type* dst, arma::uword n) const
+			{
+				rect_sub_pix_column(src1, src2, dst, n, a11, a12, a21, a22);
+			}
+
+			/// Interpolates two horizontal neighbors.
+			inline pixel_type border(pixel_type p, pixel_type q) const
+			{
+				return arma_ext::saturate_cast<pixel_type>((elem_type)p * b1 + (elem_type)q * b2);
+			}
+		};
+
+		/**
+		 *	@brief	Bilinear weights of #rect_sub_pix in fixed point.<br>
+		 *			The weights are rounded, and the largest one absorbs the rounding errors so that they sum to 2^bits exactly.
+		 */
+		template <typename pixel_type, typename elem_type>
+		struct bilinear_weights<pixel_type, elem_type, true>
+		{
+			static const int bits = interpolation_traits<pixel_type>::bits;
+
+			int a11, a12, a21, a22;	///< the weights of the four neighbors
+			int b1, b2;				///< the weights of the two horizontal neighbors
+
+			bilinear_weights(elem_type ox, elem_type oy)
+			{
+				const double scale = (double)(1 << bits);
+				double w[4] = { (1 - ox) * (1 - oy), ox * (1 - oy), (1 - ox) * oy, ox * oy };
+				int q[4], sum = 0, k = 0;
+				for (int j = 0 ; j < 4 ; j++) {
+					q[j] = (int)std::floor(w[j] * scale + 0.5);
+					sum += q[j];
+					if (w[j] > w[k]) k = j;
+				}
+				q[k] += (1 << bits) - sum;
+
+				a11 = q[0]; a12 = q[1]; a21 = q[2]; a22 = q[3];
+				b2 = (int)std::floor(ox * scale + 0.5);
+				b1 = (1 << bits) - b2;
+			}
+
+			/// Interpolates @c n rows between two adjacent columns.
+			inline void column(const pixel_type* src1, const pixel_type* src2, pixel_type* dst, arma::uword n) const
+			{
+				const int delta = 1 << (bits - 1);
+				arma::uword i = rect_sub_pix_fixed_simd(src1, src2, dst, 0, n, a11, a12, a21, a22, bits);
+
+				for ( ; i < n ; i++)
+					dst[i] = arma_ext::saturate_cast<pixel_type>((src1[i] * a11 + src1[i + 1] * a21 + src2[i] * a12 + src2[i + 1] * a22 + delta) >> bits);
+			}
+
+			/// Interpolates two horizontal neighbors.
+			inline pixel_type border(pixel_type p, pixel_type q) const
+			{
+				return arma_ext::saturate_cast<pixel_type>((p * b1 + q * b2 + (1 << (bits - 1))) >> bits);
+			}
+		};
+
+		/// The distance between two columns of a matrix or a ::col_major view.
+		template <typename T>
+		inline arma::uword column_stride(const arma::Mat<T>& m) { return m.n_rows; }
+		template <typename T>
+		inline arma::uword column_stride(const image_view<T>& v) { assert(v.layout() == col_major); return v.stride(); }
+
+		/// Computes the top-left source pixel of the patch around (cx, cy) and the offsets of the patch from it.
+		template <typename elem_type>
+		inline void rect_sub_pix_origin(arma::uword width, arma::uword height, elem_type cx, elem_type cy, int& ipx, int& ipy, elem_type& ox, elem_type& oy)
+		{
+			cx -= (elem_type)(width - 1) * (elem_type)0.5;
+			cy -= (elem_type)(height - 1) * (elem_type)0.5;
+
+			ipx = (int)std::floor(cx);
+			ipy = (int)std::floor(cy);
+
+			ox = cx - (elem_type)ipx;
+			oy = cy - (elem_type)ipy;
+		}
+
+		/**
+		 *	@brief	Retrieves the pixel rectangle of which top-left source pixel is (ipx, ipy) into a column-major buffer.<br>
+		 *			It only compares the rectangle with the bounds of @c img, so a crop of the image which contains
+		 *			the pixels of the rectangle inside the image gives the same patch with the origin shifted.
+		 */
+		template <typename image_type, typename pixel_type, typename weights_type>
+		void rect_sub_pix_at(const image_type& img, arma::uword width, arma::uword height, int ipx, int ipy, const weights_type& weights, pixel_type* dst, bool parallel)
+		{
+			typedef typename arma_ext::size_type size_type;
+
+			const size_type stride = column_stride(img);
+
+			if (0 <= ipx && ipx + width < img.n_cols &&
+				0 <= ipy && ipy + height < img.n_rows) {
+				// extracted rectangle is totally inside the image
+				const pixel_type* src = img.colptr(ipx) + ipy;
+				if (parallel) {
+#ifdef USE_PPL
+					concurrency::parallel_for(size_type(0), width, [&](size_type j) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+					for (int sj = 0 ; sj < (int)width ; sj++) {
+						size_type j = (size_type)sj;
+#else
+					for (size_type j = 0 ; j < width ; j++) {
+#endif
+						weights.column(src + j * stride, src + (j + 1) * stride, dst + j * height, height);
+#ifdef USE_PPL
+					});
+#else
+					}
+#endif
+				} else {
+					for (size_type j = 0 ; j < width ; j++)
+						weights.column(src + j * stride, src + (j + 1) * stride, dst + j * height, height);
+				}
+			} else {
+				arma::ivec4 r;
+
+				// adjust rectangle
+				int sox = 0, soy = 0;
+
+				// -------- begin --------
+				if (ipx >= 0) {
+					sox += ipx;	// + ipx
+					r[0] = 0;
+				} else {
+					r[0] = -ipx;
+					if (r[0] > (int)width)
+						r[0] = width;
+				}
+
+				if (ipx + (int)width < (int)img.n_cols)
+					r[2] = width;
+				else {
+					r[2] = (int)img.n_cols - ipx - 1;
+					if (r[2] < 0) {
+						sox += r(2);	// + width
+						r[2] = 0;
+					}
+				}
+
+				if (ipy >= 0) {
+					soy += ipy;	// + ipy
+					r[1] = 0;
+				} else {
+					r[1] = -ipy;
+					if (r[1] > (int)height)
+						r[1] = height;
+				}
+
+				if (ipy + (int)height < (int)img.n_rows)
+					r[3] = height;
+				else {
+					r[3] = (int)img.n_rows - ipy - 1;
+					if (r[3] < 0) {
+						soy += r[3];	// + height
+						r[3] = 0;
+					}
+				}
+				// --------- end ---------
+
+				// the row i of the patch is the row i - r[1] of the columns below, which start at the row soy
+
+				const pixel_type* src1 = img.colptr(sox) + soy;
+				for (size_type j = 0 ; j < width ; j++) {
+					pixel_type* ptr = dst + j * height;
+					const pixel_type* src2 = src1 + stride;
+
+					if ((int)j < r[0] || (int)j >= r[2])
+						src2 -= stride;
+
+					size_type i = 0;
+					for (; i < (size_type)r(1) ; i++)
+						ptr[i] = weights.border(src1[0], src2[0]);
+
+					if (i < (size_type)r(3)) {
+						weights.column(src1 + (i - r[1]), src2 + (i - r[1]), ptr + i, (size_type)r(3) - i);
+						i = (size_type)r(3);
+					}
+
+					for ( ; i < height ; i++)
+						ptr[i] = weights.border(src1[r[3] - r[1]], src2[r[3] - r[1]]);
+
+					if ((int)j < r[2])
+						src1 = src2;
+				}
+			}
+		}
+
+		/**
+		 *	@brief	Retrieves a pixel rectangle into a column-major buffer, see #getRectSubPix.
+		 *	@param dst		the patch of @c width x @c height pixels
+		 *	@param parallel	whether to interpolate the columns in parallel
+		 */
+		template <typename image_type, typename pixel_type, typename elem_type>
+		void rect_sub_pix(const image_type& img, arma::uword width, arma::uword height, elem_type cx, elem_type cy, pixel_type* dst, bool parallel)
+		{
+			int ipx, ipy;
+			elem_type ox, oy;
+			rect_sub_pix_origin(width, height, cx, cy, ipx, ipy, ox, oy);
+			rect_sub_pix_at(img, width, height, ipx, ipy, bilinear_weights<pixel_type, elem_type>(ox, oy), dst, parallel);
+		}
+
+		/**
+		 *	@brief	Gathers the source pixels of the rectangle at (ipx, ipy) of a ::row_major view into a ::col_major crop.
+		 *	@param buffer	at least (width + 1) x (height + 1) pixels
+		 *	@param x0, y0	the origin of the crop in the view
+		 */
+		template <typename pixel_type>
+		image_view<pixel_type> rect_sub_pix_crop(const image_view<pixel_type>& img, arma::uword width, arma::uword height, int ipx, int ipy,
+												 pixel_type* buffer, int& x0, int& y0)
+		{
+			const int w = (int)img.width(), h = (int)img.height();
+			x0 = std::min(std::max(ipx, 0), w - 1);
+			y0 = std::min(std::max(ipy, 0), h - 1);
+			const int x1 = std::min(std::max(ipx + (int)width, 0), w - 1);
+			const int y1 = std::min(std::max(ipy + (int)height, 0), h - 1);
+
+			const arma::uword cw = (arma::uword)(x1 - x0 + 1), ch = (arma::uword)(y1 - y0 + 1);
+			transpose_copy(img.memptr() + (arma::uword)y0 * img.stride() + x0, img.stride(), buffer, ch, cw, ch);
+			return image_view<pixel_type>(buffer, cw, ch, 0, col_major);
+		}
+
+		/**
+		 *	@brief	#rect_sub_pix on a view.<br>
+		 *			The source pixels of the patch of a ::row_major view are gathered into a ::col_major crop first,
+		 *			so that the patch is interpolated exactly as on an #Image, including the replicated border.
+		 */
+		template <typename pixel_type, typename elem_type>
+		void rect_sub_pix(const image_view<pixel_type>& img, arma::uword width, arma::uword height, elem_type cx, elem_type cy, pixel_type* dst, bool parallel)
+		{
+			if (img.layout() == col_major) {
+				rect_sub_pix<image_view<pixel_type> >(img, width, height, cx, cy, dst, parallel);
+				return;
+			}
+
+			int ipx, ipy, x0, y0;
+			elem_type ox, oy;
+			rect_sub_pix_origin(width, height, cx, cy, ipx, ipy, ox, oy);
+
+			pooled_image<pixel_type> buffer(width + 1, height + 1);
+			const image_view<pixel_type> crop = rect_sub_pix_crop(img, width, height, ipx, ipy, buffer->memptr(), x0, y0);
+			rect_sub_pix_at(crop, width, height, ipx - x0, ipy - y0, bilinear_weights<pixel_type, elem_type>(ox, oy), dst, parallel);
+		}
+
+		/// Retrieves the patches around @c centers into the slices of @c out, see the batched #getRectSubPix.
+		template <typename image_type, typename elem_type>
+		void rect_sub_pix_batch(const image_type& img, Size<arma_ext::uword> patchsize, const arma::Mat<elem_type>& centers, arma::Cube<typename image_type::elem_type>& out)
+		{
+			typedef typename arma_ext::size_type size_type;
+
+			assert(centers.n_rows == 2);
+			if (out.n_rows != patchsize.height() || out.n_cols != patchsize.width() || out.n_slices != centers.n_cols)
+				out.set_size(patchsize.height(), patchsize.width(), centers.n_cols);
+
+#ifdef USE_PPL
+			concurrency::parallel_for(size_type(0), (size_type)centers.n_cols, [&](size_type k) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+			for (int sk = 0 ; sk < (int)centers.n_cols ; sk++) {
+				size_type k = (size_type)sk;
+#else
+			for (size_type k = 0 ; k < centers.n_cols ; k++) {
+#endif
+				rect_sub_pix(img, patchsize.width(), patchsize.height(), centers(0, k), centers(1, k), out.slice_memptr(k), false);
+#ifdef USE_PPL
+			});
+#else
+			}
+#endif
+		}
+
+		/**
+		 *	@brief	#rect_sub_pix_batch on a view.<br>
+		 *			The source pixels of each patch of a ::row_major view are gathered into a crop, see #rect_sub_pix,
+		 *			in a buffer taken before the patches run in parallel.
+		 */
+		template <typename pixel_type, typename elem_type>
+		void rect_sub_pix_batch(const image_view<pixel_type>& img, Size<arma_ext::uword> patchsize, const arma::Mat<elem_type>& centers, arma::Cube<pixel_type>& out)
+		{
+			typedef typename arma_ext::size_type size_type;
+
+			if (img.layout() == col_major) {
+				rect_sub_pix_batch<image_view<pixel_type> >(img, patchsize, centers, out);
+				return;
+			}
+
+			assert(centers.n_rows == 2);
+			const size_type width = patchsize.width(), height = patchsize.height();
+			if (out.n_rows != height || out.n_cols != width || out.n_slices != centers.n_cols)
+				out.set_size(height, width, centers.n_cols);
+
+			pooled_image<pixel_type> crops(centers.n_cols, (width + 1) * (height + 1));
+
+#ifdef USE_PPL
+			concurrency::parallel_for(size_type(0), (size_type)centers.n_cols, [&](size_type k) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+			for (int sk = 0 ; sk < (int)centers.n_cols ; sk++) {
+				size_type k = (size_type)sk;
+#else
+			for (size_type k = 0 ; k < centers.n_cols ; k++) {
+#endif
+				int ipx, ipy, x0, y0;
+				elem_type ox, oy;
+				rect_sub_pix_origin(width, height, centers(0, k), centers(1, k), ipx, ipy, ox, oy);
+
+				const image_view<pixel_type> crop = rect_sub_pix_crop(img, width, height, ipx, ipy, crops->colptr(k), x0, y0);
+				rect_sub_pix_at(crop, width, height, ipx - x0, ipy - y0, bilinear_weights<pixel_type, elem_type>(ox, oy), out.slice_memptr(k), false);
+#ifdef USE_PPL
+			});
+#else
+			}
+#endif
+		}
+	}
+
+	/**
+	 *	@brief	Retrieves a pixel rectangle from an image with sub-pixel accuracy.
+	 *	@param img source image
+	 *	@param patchsize	The size of the extracted patch.
+	 *	@param center		The coordinate of the center of the extracted rectangle within the source image.
+	 *						The center must be inside of image.
+	 *	@return	Extracted patch that has the size @c patchsize and the same format as @c img.
+	 *			This function extracts pixels from src:
+	 *			\f[
+	 *				dst(x, y) = src(x + center.x - (dst.cols - 1) * 0.5, y + center.y - (dst.rows - 1) * 0.5)
+	 *			\f]
+	 *			where the values of the pixels at non-integer coordinates are retrieved using bilinear interpolation.
+	 *			While the center of the rectangle must be inside the image, parts of the rectangle may be outside.
+	 *			In this case, extrapolate the pixel values by replication border condition.
+	 *	@note	8-bit and 16-bit pixels are interpolated in fixed point, see #interpolation_traits.
+	 */
+	template <typename pixel_type, typename vec_type>
+	static arma::Mat<pixel_type> getRectSubPix(const Image<pixel_type>& img, Size<arma_ext::uword> patchsize, const vec_type center)
+	{
+		typedef typename vec_type::elem_type elem_type;
+		arma::Mat<pixel_type> out(patchsize.height(), patchsize.width());
+
+		detail::rect_sub_pix(img, patchsize.width(), patchsize.height(), (elem_type)center[0], (elem_type)center[1], out.memptr(), true);
+                                      
+		return out;
+	}
+
+	/**
+	 *	@brief	Retrieves many pixel rectangles of the same size from an image with sub-pixel accuracy.
+	 *	@param img			source image
+	 *	@param patchsize	The size of the extracted patches.
+	 *	@param centers		The coordinates of the centers of the rectangles, one per column.
+	 *	@param out			The extracted patches, one per slice. It is reallocated only if its size differs,
+	 *						so the same cube can be reused for every frame.
+	 *	@note	The patches are extracted as #getRectSubPix does, in parallel when @c USE_PPL or @c USE_OPENMP is defined.
+	 *			The interior rows are interpolated with SSE2/AVX2, in fixed point for 8-bit and 16-bit pixels
+	 *			(see #interpolation_traits), and in double precision for single precision pixels.
+	 */
+	template <typename pixel_type, typename elem_type>
+	void getRectSubPix(const Image<pixel_type>& img, Size<arma_ext::uword> patchsize, const arma::Mat<elem_type>& centers, arma::Cube<pixel_type>& out)
+	{
+		detail::rect_sub_pix_batch(img, patchsize, centers, out);
+	}
+
+	/// #getRectSubPix on a view, which may be ::row_major.
+	template <typename pixel_type, typename vec_type>
+	static arma::Mat<pixel_type> getRectSubPix(const image_view<pixel_type>& img, Size<arma_ext::uword> patchsize, const vec_type center)
+	{
+		typedef typename vec_type::elem_type elem_type;
+		arma::Mat<pixel_type> out(patchsize.height(), patchsize.width());
+
+		detail::rect_sub_pix(img, patchsize.width(), patchsize.height(), (elem_type)center[0], (elem_type)center[1], out.memptr(), true);
+
+		return out;
+	}
+
+	/// The batched #getRectSubPix on a view, which may be ::row_major.
+	template <typename pixel_type, typename elem_type>
+	void getRectSubPix(const image_view<pixel_type>& img, Size<arma_ext::uword> patchsize, const arma::Mat<elem_type>& centers, arma::Cube<pixel_type>& out)
+	{
+		detail::rect_sub_pix_batch(img, patchsize, centers, out);
+	}
+
+	/// #getRectSubPix on a read-only view, such as a frame of a pack file.
+	template <typename pixel_type, typename vec_type>
+	static arma::Mat<pixel_type> getRectSubPix(const image_view<const pixel_type>& img, Size<arma_ext::uword> patchsize, const vec_type center)
+	{
+		return getRectSubPix(detail::mutable_view(img), patchsize, center);
+	}
+
+	/// The batched #getRectSubPix on a read-only view.
+	template <typename pixel_type, typename elem_type>
+	void getRectSubPix(const image_view<const pixel_type>& img, Size<arma_ext::uword> patchsize, const arma::Mat<elem_type>& centers, arma::Cube<pixel_type>& out)
+	{
+		detail::rect_sub_pix_batch(detail::mutable_view(img), patchsize, centers, out);
+	}
+		
+	namespace detail
+	{
+		/// The number of columns processed by a task of #blur.
+		const arma::uword blur_band_cols = 64;
+
+		/// The type in which #blur accumulates, single precision unless the pixels are double precision.
+		template <typename pixel_type> struct blur_work_type { typedef float result; };
+		template <> struct blur_work_type<double> { typedef double result; };
+
+		/// Computes dst[i] += w * src[i] for the elements [i, n); no vectorized kernel by default.
+		template <typename T>
+		inline arma::uword blur_axpy_simd(T*, const T*, T, arma::uword i, arma::uword)
+		{
+			return i;
+		}
+
+#if ENABLE_SSE2
+		/// SSE2 version of #blur_axpy.
+		inline arma::uword blur_axpy_sse2(float* dst, const float* src, float w, arma::uword i, arma::uword n)
+		{
+			const __m128 w4 = _mm_set1_ps(w);
+			for ( ; i + 4 <= n ; i += 4)
+				_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), w4)));
+			return i;
+		}
+
+		/// SSE2 version of #blur_axpy.
+		inline arma::uword blur_axpy_sse2(double* dst, const double* src, double w, arma::uword i, arma::uword n)
+		{
+			const __m128d w2 = _mm_set1_pd(w);
+			for ( ; i + 2 <= n ; i += 2)
+				_mm_storeu_pd(dst + i, _mm_add_pd(_mm_loadu_pd(dst + i), _mm_mul_pd(_mm_loadu_pd(src + i), w2)));
+			return i;
+		}
+#endif
+
+#if ENABLE_AVX2
+		/// AVX2 version of #blur_axpy.
+		AUX_TARGET_AVX2 inline arma::uword blur_axpy_avx2(float* dst, const float* src, float w, arma::uword i, arma::uword n)
+		{
+			const __m256 w8 = _mm256_set1_ps(w);
+			for ( ; i + 8 <= n ; i += 8)
+				_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), w8)));
+			return i;
+		}
+
+		/// AVX2 version of #blur_axpy.
+		AUX_TARGET_AVX2 inline arma::uword blur_axpy_avx2(double* dst, const double* src, double w, arma::uword i, arma::uword n)
+		{
+			const __m256d w4 = _mm256_set1_pd(w);
+			for ( ; i + 4 <= n ; i += 4)
+				_mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_loadu_pd(dst + i), _mm256_mul_pd(_mm256_loadu_pd(src + i), w4)));
+			return i;
+		}
+#endif
+
+#if ENABLE_SSE2
+		/// Dispatches the single precision #blur_axpy.
+		inline arma::uword blur_axpy_simd(float* dst, const float* src, float w, arma::uword i, arma::uword n)
+		{
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				i = blur_axpy_avx2(dst, src, w, i, n);
+#endif
+			return (simd_support() >= simd_sse2) ? blur_axpy_sse2(dst, src, w, i, n) : i;
+		}
+
+		/// Dispatches the double precision #blur_axpy.
+		inline arma::uword blur_axpy_simd(double* dst, const double* src, double w, arma::uword i, arma::uword n)
+		{
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				i = blur_axpy_avx2(dst, src, w, i, n);
+#endif
+			return (simd_support() >= simd_sse2) ? blur_axpy_sse2(dst, src, w, i, n) : i;
+		}
+#endif
+
+		/// Computes dst[i] += w * src[i] for the elements [0, n).
+		template <typename T>
+		inline void blur_axpy(T* dst, const T* src, T w, arma::uword n)
+		{
+			arma::uword i = blur_axpy_simd(dst, src, w, 0, n);
+			for ( ; i < n ; i++)
+				dst[i] += w * src[i];
+		}
+
+		/**
+		 *	@brief	Convolves a column with a 1-D kernel, keeping the central part as @c conv2 with @c same does.<br>
+		 *			With the zero padding, each tap adds a shifted range of the column, so the convolution is a sum of #blur_axpy.
+		 */
+		template <typename T>
+		inline void blur_column(const T* src, T* dst, arma::uword n, const T* k, arma::uword nk)
+		{
+			const int c = (int)nk / 2;
+
+			std::fill(dst, dst + n, (T)0);
+			for (arma::uword i = 0 ; i < nk ; i++) {
+				// dst[y] += k[i] * src[y + c - i]
+				const int off = c - (int)i;
+				const int y0 = std::max(0, -off), y1 = std::min((int)n, (int)n - off);
+				if (y0 < y1)
+					blur_axpy(dst + y0, src + y0 + off, k[i], (arma::uword)(y1 - y0));
+			}
+		}
+
+		/**
+		 *	@brief	Factorizes a kernel of rank 1 into a column and a row kernel, h = u v^T.
+		 *	@return	@c false if the kernel is not separable
+		 */
+		inline bool separate_kernel(const mat& h, vec& u, vec& v)
+		{
+			// the largest coefficient gives the most accurate factors
+			arma::uword p = 0, q = 0;
+			double m = 0;
+			for (arma::uword j = 0 ; j < h.n_cols ; j++)
+				for (arma::uword i = 0 ; i < h.n_rows ; i++)
+					if (std::abs(h(i, j)) > m) {
+						m = std::abs(h(i, j));
+						p = i; q = j;
+					}
+
+			if (m == 0) return false;
+
+			u.set_size(h.n_rows);
+			v.set_size(h.n_cols);
+			for (arma::uword i = 0 ; i < h.n_rows ; i++)
+				u[i] = h(i, q);
+			for (arma::uword j = 0 ; j < h.n_cols ; j++)
+				v[j] = h(p, j) / h(p, q);
+
+			const double tol = m * 1e-10;
+			for (arma::uword j = 0 ; j < h.n_cols ; j++)
+				for (arma::uword i = 0 ; i < h.n_rows ; i++)
+					if (std::abs(h(i, j) - u[i] * v[j]) > tol)
+						return false;
+
+			return true;
+		}
+
+		/// Blurs the columns [x0, x1) with separable kernels, see #blur; @c buf holds a column.
+		template <typename image_type, typename work_type>
+		void blur_separable_band(const image_type& img, arma::Mat<work_type>& tmp, Image<typename image_type::elem_type>& out,
+								 const work_type* u, arma::uword nu, const work_type* v, arma::uword nv, work_type* buf,
+								 arma::uword x0, arma::uword x1, bool vertical)
+		{
+			typedef typename image_type::elem_type pixel_type;
+
+			const arma::uword n = img.n_rows;
+
+			for (arma::uword x = x0 ; x < x1 ; x++) {
+				if (vertical) {
+					// convolve the columns with u
+					load_column(img, x, buf);
+					blur_column(buf, tmp.colptr(x), n, u, nu);
+				} else {
+					// convolve the rows with v as weighted sums of columns
+					const int c = (int)nv / 2;
+					std::fill(buf, buf + n, (work_type)0);
+					for (arma::uword j = 0 ; j < nv ; j++) {
+						const int sx = (int)x + c - (int)j;
+						if (sx >= 0 && sx < (int)img.n_cols)
+							blur_axpy(buf, tmp.colptr(sx), v[j], n);
+					}
+
+					pixel_type* dst = out.colptr(x);
+					for (arma::uword y = 0 ; y < n ; y++)
+						dst[y] = arma_ext::saturate_cast<pixel_type>(buf[y]);
+				}
+			}
+		}
+
+		/**
+		 *	@brief	Blurs an image with separable kernels in two 1-D passes, in parallel bands if enabled.
+		 *	@note	All the buffers, including a column per band, are taken from the pool before the bands run.
+		 */
+		template <typename image_type>
+		void blur_separable(const image_type& img, const vec& u, const vec& v, Image<typename image_type::elem_type>& out)
+		{
+			typedef typename image_type::elem_type pixel_type;
+			typedef typename blur_work_type<pixel_type>::result work_type;
+
+			out.resize(img.n_cols, img.n_rows);
+			if (img.n_elem == 0) return;
+
+			const arma::uword n_bands = (img.n_cols + blur_band_cols - 1) / blur_band_cols;
+			pooled_image<work_type> buffer(img.n_cols, img.n_rows), columns(n_bands, img.n_rows), kernels(u.n_elem + v.n_elem, 1);
+			arma::Mat<work_type>& tmp = *buffer;
+			work_type* ku = kernels->memptr();
+			work_type* kv = ku + u.n_elem;
+			for (arma::uword i = 0 ; i < u.n_elem ; i++) ku[i] = (work_type)u[i];
+			for (arma::uword i = 0 ; i < v.n_elem ; i++) kv[i] = (work_type)v[i];
+
+			for (int pass = 0 ; pass < 2 ; pass++) {
+#if defined(USE_PPL)
+				concurrency::parallel_for(arma::uword(0), n_bands, [&](arma::uword b) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+				for (int sb = 0 ; sb < (int)n_bands ; sb++) {
+					arma::uword b = (arma::uword)sb;
+#else
+				for (arma::uword b = 0 ; b < n_bands ; b++) {
+#endif
+					blur_separable_band(img, tmp, out, ku, u.n_elem, kv, v.n_elem, columns->colptr(b),
+										b * blur_band_cols, std::min((b + 1) * blur_band_cols, (arma::uword)img.n_cols), pass == 0);
+#if defined(USE_PPL)
+				});
+#else
+				}
+#endif
+			}
+		}
+	}
+
+	/**
+	 *	@brief	Gaussian blur with given blur kernel.
+	 *	@param	img		An input image.
+	 *	@param	h		The blur kernel.
+	 *	@param	out		The blurred image, which is reallocated only if its size differs from that of @c img.
+	 *	@note	A separable kernel, such as a Gaussian kernel, is factorized and applied in two 1-D passes
+	 *			of which cost is linear in the kernel size; they accumulate in single precision unless the pixels are double,
+	 *			are vectorized with SSE2/AVX2 and run in parallel when @c USE_PPL or @c USE_OPENMP is defined.
+	 *			Their buffers come from image_pool::local, so blurring frames of the same size into the same @c out does not allocate.
+	 *			Other kernels are applied by @c conv2 in double precision.
+	 *	@see	#boxFilter in integral.hpp, of which cost does not depend on the size of the box.
+	 */
+	template <typename pixel_type>
+	inline void blur(const Image<pixel_type>& img, const mat& h, Image<pixel_type>& out)
+	{
+		vec u, v;
+		if (detail::separate_kernel(h, u, v))
+			detail::blur_separable(img, u, v, out);
+		else
+			out = Image<pixel_type>(arma_ext::conv2(conv_to<mat>::from(img), h, arma_ext::same).eval());
+	}
+
+	/**
+	 *	@brief	Gaussian blur with given blur kernel, see #blur.
+	 *	@return	The blurred image.
+	 */
+    template <typename pixel_type>
+	inline Image<pixel_type> blur(const Image<pixel_type>& img, const mat& h)
+	{
+		Image<pixel_type> out;
+		blur(img, h, out);
+		return out;
+	}
+
+	/**
+	 *	@brief	Gaussian blur of a view with given blur kernel, see #blur.
+	 *	@note	The columns of a ::row_major view are gathered from its rows in the vertical pass, which is the only one reading the view.
+	 */
+	template <typename pixel_type>
+	inline void blur(const image_view<pixel_type>& img, const mat& h, Image<pixel_type>& out)
+	{
+		vec u, v;
+		if (detail::separate_kernel(h, u, v)) {
+			detail::blur_separable(img, u, v, out);
+			return;
+		}
+
+		mat m(img.n_rows, img.n_cols);
+		for (arma::uword x = 0 ; x < img.n_cols ; x++)
+			detail::load_column(img, x, m.colptr(x));
+
+		out = Image<pixel_type>(arma_ext::conv2(m, h, arma_ext::same).eval());
+	}
+
+	/// Gaussian blur of a view with given blur kernel, see #blur.
+	template <typename pixel_type>
+	inline Image<pixel_type> blur(const image_view<pixel_type>& img, const mat& h)
+	{
+		Image<pixel_type> out;
+		blur(img, h, out);
+		return out;
+	}
+
+	/// Gaussian blur of a read-only view, such as a frame of a pack file, see #blur.
+	template <typename pixel_type>
+	inline void blur(const image_view<const pixel_type>& img, const mat& h, Image<pixel_type>& out)
+	{
+		blur(detail::mutable_view(img), h, out);
+	}
+
+	/// Gaussian blur of a read-only view with given blur kernel, see #blur.
+	template <typename pixel_type>
+	inline Image<pixel_type> blur(const image_view<const pixel_type>& img, const mat& h)
+	{
+		Image<pixel_type> out;
+		blur(detail::mutable_view(img), h, out);
+		return out;
+	}
+
+	namespace detail
+	{
+		/// The number of rows processed by a task of the horizontal pass of #gaussianBlur.
+		const arma::uword recursive_band_rows = 256;
+
+		/**
+		 *	@brief	Coefficients of the recursive Gaussian filter.
+		 *	@see	I. T. Young and L. J. van Vliet, "Recursive implementation of the Gaussian filter",
+		 *			Signal Processing 44, 1995.
+		 */
+		struct recursive_gaussian
+		{
+			double B;			///< the gain of the input
+			double b1, b2, b3;	///< the feedback coefficients, normalized by b0
+
+			explicit recursive_gaussian(double sigma)
+			{
+				assert(sigma >= 0.5);
+
+				const double q = (sigma >= 2.5) ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * std::sqrt(1 - 0.26891 * sigma);
+				const double q2 = q * q, q3 = q2 * q;
+				const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+
+				b1 = (2.44413 * q + 2.85619 * q2 + 1.26661 * q3) / b0;
+				b2 = -(1.4281 * q2 + 1.26661 * q3) / b0;
+				b3 = 0.422205 * q3 / b0;
+				B = 1 - (b1 + b2 + b3);
+			}
+
+			/// Filters a sequence forward and backward in place, with zeros outside.
+			void filter(double* p, arma::uword n) const
+			{
+				double w1 = 0, w2 = 0, w3 = 0;
+				for (arma::uword i = 0 ; i < n ; i++) {
+					const double w = B * p[i] + b1 * w1 + b2 * w2 + b3 * w3;
+					w3 = w2; w2 = w1; w1 = p[i] = w;
+				}
+
+				w1 = w2 = w3 = 0;
+				for (arma::uword i = n ; i-- > 0 ; ) {
+					const double w = B * p[i] + b1 * w1 + b2 * w2 + b3 * w3;
+					w3 = w2; w2 = w1; w1 = p[i] = w;
+				}
+			}
+
+			/// Filters the rows [y0, y1) of a matrix forward and backward in place, a column at a time.
+			void filter_rows(arma::mat& m, const double* zero, arma::uword y0, arma::uword y1) const
+			{
+				const arma::uword n = m.n_cols;
+
+				for (arma::uword x = 0 ; x < n ; x++) {
+					double* c = m.colptr(x);
+					const double* c1 = (x >= 1) ? m.colptr(x - 1) : zero;
+					const double* c2 = (x >= 2) ? m.colptr(x - 2) : zero;
+					const double* c3 = (x >= 3) ? m.colptr(x - 3) : zero;
+					for (arma::uword y = y0 ; y < y1 ; y++)
+						c[y] = B * c[y] + b1 * c1[y] + b2 * c2[y] + b3 * c3[y];
+				}
+
+				for (arma::uword x = n ; x-- > 0 ; ) {
+					double* c = m.colptr(x);
+					const double* c1 = (x + 1 < n) ? m.colptr(x + 1) : zero;
+					const double* c2 = (x + 2 < n) ? m.colptr(x + 2) : zero;
+					const double* c3 = (x + 3 < n) ? m.colptr(x + 3) : zero;
+					for (arma::uword y = y0 ; y < y1 ; y++)
+						c[y] = B * c[y] + b1 * c1[y] + b2 * c2[y] + b3 * c3[y];
+				}
+			}
+		};
+	}
+
+	/**
+	 *	@brief	Gaussian blur of which cost per pixel is independent of the standard deviation.
+	 *	@param	img		An input image.
+	 *	@param	sigma	The standard deviation of the Gaussian, at least 0.5.
+	 *	@param	out		The blurred image, which is reallocated only if its size differs from that of @c img.
+	 *	@note	The Gaussian is approximated by the third order recursive filter of Young and van Vliet,
+	 *			applied forward and backward along the columns and then along the rows in double precision.
+	 *			The weights are normalized over the pixels inside the image, so the borders do not darken.
+	 *			The approximation is coarse for small deviations, for which #blur with a sampled kernel is as fast.
+	 *			The columns and the bands of rows are filtered in parallel when @c USE_PPL or @c USE_OPENMP is defined.
+	 *			The buffers come from image_pool::local, so blurring frames of the same size into the same @c out does not allocate.
+	 */
+	template <typename pixel_type>
+	void gaussianBlur(const Image<pixel_type>& img, double sigma, Image<pixel_type>& out)
+	{
+		typedef typename Image<pixel_type>::size_type size_type;
+
+		out.resize(img.n_cols, img.n_rows);
+		if (img.n_elem == 0) return;
+
+		const detail::recursive_gaussian g(sigma);
+
+		// the responses to the image of ones give the normalization
+		pooled_image<double> buffer(img.n_cols, img.n_rows), norms(2 * img.n_rows + img.n_cols, 1);
+		mat& tmp = *buffer;
+		double* ny = norms->memptr();
+		double* zero = ny + img.n_rows;
+		double* nx = zero + img.n_rows;
+		std::fill(ny, ny + img.n_rows, 1.0);
+		std::fill(zero, zero + img.n_rows, 0.0);
+		std::fill(nx, nx + img.n_cols, 1.0);
+		g.filter(ny, img.n_rows);
+		g.filter(nx, img.n_cols);
+
+		// vertical pass
+#if defined(USE_PPL)
+		concurrency::parallel_for(size_type(0), (size_type)img.n_cols, [&](size_type x) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+		for (int sx = 0 ; sx < (int)img.n_cols ; sx++) {
+			size_type x = (size_type)sx;
+#else
+		for (size_type x = 0 ; x < img.n_cols ; x++) {
+#endif
+			const pixel_type* src = img.colptr(x);
+			double* dst = tmp.colptr(x);
+			for (size_type y = 0 ; y < img.n_rows ; y++)
+				dst[y] = (double)src[y];
+			g.filter(dst, img.n_rows);
+#if defined(USE_PPL)
+		});
+#else
+		}
+#endif
+
+		// horizontal pass
+		const size_type n_bands = (img.n_rows + detail::recursive_band_rows - 1) / detail::recursive_band_rows;
+#if defined(USE_PPL)
+		concurrency::parallel_for(size_type(0), n_bands, [&](size_type b) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+		for (int sb = 0 ; sb < (int)n_bands ; sb++) {
+			size_type b = (size_type)sb;
+#else
+		for (size_type b = 0 ; b < n_bands ; b++) {
+#endif
+			g.filter_rows(tmp, zero, b * detail::recursive_band_rows, std::min((b + 1) * detail::recursive_band_rows, (size_type)img.n_rows));
+#if defined(USE_PPL)
+		});
+#else
+		}
+#endif
+
+		for (size_type x = 0 ; x < img.n_cols ; x++) {
+			const double* src = tmp.colptr(x);
+			pixel_type* dst = out.colptr(x);
+			for (size_type y = 0 ; y < img.n_rows ; y++)
+				dst[y] = arma_ext::saturate_cast<pixel_type>(src[y] / (ny[y] * nx[x]));
+		}
+	}
+
+	/**
+	 *	@brief	Gaussian blur of which cost per pixel is independent of the standard deviation, see #gaussianBlur.
+	 *	@return	The blurred image.
+	 */
+	template <typename pixel_type>
+	inline Image<pixel_type> gaussianBlur(const Image<pixel_type>& img, double sigma)
+	{
+		Image<pixel_type> out;
+		gaussianBlur(img, sigma, out);
+		return out;
+	}
+
+	/// The channel orders of 8-bit color pixels, see #color2gray
+	enum color_format
+	{
+		bgr,	///< blue, green and red, as in OpenCV
+		rgb,	///< red, green and blue
+		bgra,	///< blue, green, red and alpha
+		rgba	///< red, green, blue and alpha
+	};
+
+	namespace detail
+	{
+		/// The number of rows converted together by #color_to_gray_transposed.
+		const arma::uword gray_band_rows = transpose_tile;
+
+		/// The weights of the color to gray conversion in 14-bit fixed point, the same as those of cv::cvtColor.
+		enum { gray_shift = 14, gray_b = 1868, gray_g = 9617, gray_r = 4899 };
+
+		/**
+		 *	@brief	Gets the weights of the first three channels of a format.
+		 *	@return	the number of channels
+		 */
+		inline int gray_weights(color_format format, int* w)
+		{
+			const bool swap = (format == rgb || format == rgba);
+			w[0] = swap ? gray_r : gray_b;
+			w[1] = gray_g;
+			w[2] = swap ? gray_b : gray_r;
+			return (format == bgr || format == rgb) ? 3 : 4;
+		}
+
+#if ENABLE_SSE2
+		/**
+		 *	@brief	Deinterleaves 32 pixels of @c cn channels loaded into @c 2 cn registers.<br>
+		 *			Five layers of byte interleaving of the registers i and i + cn bring the channel c into the registers 2 c and 2 c + 1.
+		 */
+		template <int cn>
+		inline void deinterleave32_sse2(__m128i* a)
+		{
+			__m128i b[cn * 2];
+			for (int k = 0 ; k < 5 ; k++) {
+				for (int i = 0 ; i < cn ; i++) {
+					b[i * 2] = _mm_unpacklo_epi8(a[i], a[i + cn]);
+					b[i * 2 + 1] = _mm_unpackhi_epi8(a[i], a[i + cn]);
+				}
+				for (int i = 0 ; i < cn * 2 ; i++)
+					a[i] = b[i];
+			}
+		}
+
+		/// Converts 16 pixels of three channels to gray, (c0 w0 + c1 w1 + c2 w2 + 2^13) >> 14.
+		inline __m128i gray16_sse2(__m128i c0, __m128i c1, __m128i c2, __m128i w01, __m128i w2r)
+		{
+			const __m128i z = _mm_setzero_si128(), one = _mm_set1_epi16(1);
+			const __m128i c0l = _mm_unpacklo_epi8(c0, z), c0h = _mm_unpackhi_epi8(c0, z),
+						  c1l = _mm_unpacklo_epi8(c1, z), c1h = _mm_unpackhi_epi8(c1, z),
+						  c2l = _mm_unpacklo_epi8(c2, z), c2h = _mm_unpackhi_epi8(c2, z);
+
+			// (c0, c1) w01 + (c2, 1) w2r, 4 pixels each
+			__m128i p0 = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(c0l, c1l), w01), _mm_madd_epi16(_mm_unpacklo_epi16(c2l, one), w2r));
+			__m128i p1 = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(c0l, c1l), w01), _mm_madd_epi16(_mm_unpackhi_epi16(c2l, one), w2r));
+			__m128i p2 = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(c0h, c1h), w01), _mm_madd_epi16(_mm_unpacklo_epi16(c2h, one), w2r));
+			__m128i p3 = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(c0h, c1h), w01), _mm_madd_epi16(_mm_unpackhi_epi16(c2h, one), w2r));
+
+			p0 = _mm_srai_epi32(p0, gray_shift);
+			p1 = _mm_srai_epi32(p1, gray_shift);
+			p2 = _mm_srai_epi32(p2, gray_shift);
+			p3 = _mm_srai_epi32(p3, gray_shift);
+
+			return _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+		}
+
+		/// SSE2 version of #gray_row, 32 pixels at a time.
+		template <int cn>
+		inline arma::uword gray_row_sse2(const unsigned char* src, unsigned char* dst, arma::uword x, arma::uword n, const int* w)
+		{
+			const __m128i w01 = _mm_set1_epi32((w[1] << 16) | w[0]);
+			const __m128i w2r = _mm_set1_epi32(((1 << (gray_shift - 1)) << 16) | w[2]);
+
+			for ( ; x + 32 <= n ; x += 32) {
+				__m128i a[cn * 2];
+				for (int i = 0 ; i < cn * 2 ; i++)
+					a[i] = _mm_loadu_si128((const __m128i*)(src + x * cn + i * 16));
+				deinterleave32_sse2<cn>(a);
+
+				_mm_storeu_si128((__m128i*)(dst + x), gray16_sse2(a[0], a[2], a[4], w01, w2r));
+				_mm_storeu_si128((__m128i*)(dst + x + 16), gray16_sse2(a[1], a[3], a[5], w01, w2r));
+			}
+
+			return x;
+		}
+#endif
+
+#if ENABLE_AVX2
+		/// AVX2 version of #deinterleave32_sse2, each lane deinterleaves its own 32 pixels.
+		template <int cn>
+		AUX_TARGET_AVX2 inline void deinterleave32_avx2(__m256i* a)
+		{
+			__m256i b[cn * 2];
+			for (int k = 0 ; k < 5 ; k++) {
+				for (int i = 0 ; i < cn ; i++) {
+					b[i * 2] = _mm256_unpacklo_epi8(a[i], a[i + cn]);
+					b[i * 2 + 1] = _mm256_unpackhi_epi8(a[i], a[i + cn]);
+				}
+				for (int i = 0 ; i < cn * 2 ; i++)
+					a[i] = b[i];
+			}
+		}
+
+		/// AVX2 version of #gray16_sse2, 16 pixels per lane.
+		AUX_TARGET_AVX2 inline __m256i gray16_avx2(__m256i c0, __m256i c1, __m256i c2, __m256i w01, __m256i w2r)
+		{
+			const __m256i z = _mm256_setzero_si256(), one = _mm256_set1_epi16(1);
+			const __m256i c0l = _mm256_unpacklo_epi8(c0, z), c0h = _mm256_unpackhi_epi8(c0, z),
+						  c1l = _mm256_unpacklo_epi8(c1, z), c1h = _mm256_unpackhi_epi8(c1, z),
+						  c2l = _mm256_unpacklo_epi8(c2, z), c2h = _mm256_unpackhi_epi8(c2, z);
+
+			__m256i p0 = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(c0l, c1l), w01), _mm256_madd_epi16(_mm256_unpacklo_epi16(c2l, one), w2r));
+			__m256i p1 = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(c0l, c1l), w01), _mm256_madd_epi16(_mm256_unpackhi_epi16(c2l, one), w2r));
+			__m256i p2 = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(c0h, c1h), w01), _mm256_madd_epi16(_mm256_unpacklo_epi16(c2h, one), w2r));
+			__m256i p3 = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(c0h, c1h), w01), _mm256_madd_epi16(_mm256_unpackhi_epi16(c2h, one), w2r));
+
+			p0 = _mm256_srai_epi32(p0, gray_shift);
+			p1 = _mm256_srai_epi32(p1, gray_shift);
+			p2 = _mm256_srai_epi32(p2, gray_shift);
+			p3 = _mm256_srai_epi32(p3, gray_shift);
+
+			return _mm256_packus_epi16(_mm256_packs_epi32(p0, p1), _mm256_packs_epi32(p2, p3));
+		}
+
+		/// AVX2 version of #gray_row, 64 pixels at a time; the lanes take the pixels [x, x + 32) and [x + 32, x + 64).
+		template <int cn>
+		AUX_TARGET_AVX2 inline arma::uword gray_row_avx2(const unsigned char* src, unsigned char* dst, arma::uword x, arma::uword n, const int* w)
+		{
+			const __m256i w01 = _mm256_set1_epi32((w[1] << 16) | w[0]);
+			const __m256i w2r = _mm256_set1_epi32(((1 << (gray_shift - 1)) << 16) | w[2]);
+
+			for ( ; x + 64 <= n ; x += 64) {
+				__m256i a[cn * 2];
+				for (int i = 0 ; i < cn * 2 ; i++) {
+					const unsigned char* p = src + x * cn + i * 16;
+					a[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+												   _mm_loadu_si128((const __m128i*)(p + 32 * cn)), 1);
+				}
+				deinterleave32_avx2<cn>(a);
+
+				const __m256i g0 = gray16_avx2(a[0], a[2], a[4], w01, w2r);
+				const __m256i g1 = gray16_avx2(a[1], a[3], a[5], w01, w2r);
+				_mm256_storeu_si256((__m256i*)(dst + x), _mm256_permute2x128_si256(g0, g1, 0x20));
+				_mm256_storeu_si256((__m256i*)(dst + x + 32), _mm256_permute2x128_si256(g0, g1, 0x31));
+			}
+
+			return x;
+		}
+#endif
+
+		/// Dispatches the vectorized #gray_row.
+		template <int cn>
+		inline arma::uword gray_row_simd(const unsigned char* src, unsigned char* dst, arma::uword n, const int* w)
+		{
+			arma::uword x = 0;
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				x = gray_row_avx2<cn>(src, dst, x, n, w);
+#endif
+#if ENABLE_SSE2
+			if (simd_support() >= simd_sse2)
+				x = gray_row_sse2<cn>(src, dst, x, n, w);
+#else
+			(void)src; (void)dst; (void)n; (void)w;	// no kernel without SIMD
+#endif
+			return x;
+		}
+
+		/**
+		 *	@brief	Converts a row of @c n color pixels of @c cn channels to gray.
+		 *	@param w	the weights of the first three channels in #gray_shift bits fixed point
+		 */
+		inline void gray_row(const unsigned char* src, unsigned char* dst, arma::uword n, int cn, const int* w)
+		{
+			arma::uword x = (cn == 3) ? gray_row_simd<3>(src, dst, n, w) : gray_row_simd<4>(src, dst, n, w);
+
+			for (src += x * cn ; x < n ; x++, src += cn)
+				dst[x] = (unsigned char)((src[0] * w[0] + src[1] * w[1] + src[2] * w[2] + (1 << (gray_shift - 1))) >> gray_shift);
+		}
+
+		/**
+		 *	@brief	Converts a row-major color image to a column-major gray image in a single pass.<br>
+		 *			Bands of rows are converted into a buffer which stays in cache, then transposed into @c dst by #transpose_copy.
+		 *	@param step		the distance between two rows of @c src in bytes
+		 *	@param format	the channel order of @c src
+		 *	@param dst		the gray image of @c n_rows x @c n_cols
+		 */
+		template <typename pixel_type>
+		void color_to_gray_transposed(const unsigned char* src, size_t step, color_format format, pixel_type* dst, arma::uword n_rows, arma::uword n_cols)
+		{
+			int w[3];
+			const int cn = gray_weights(format, w);
+
+			// the row y of the image is the column y of the buffer, which is taken before the bands run
+			const arma::uword n_bands = (n_rows + gray_band_rows - 1) / gray_band_rows;
+			pooled_image<unsigned char> buffer(n_rows, n_cols);
+#if defined(USE_PPL)
+			concurrency::parallel_for(arma::uword(0), n_bands, [&](arma::uword b) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+			for (int sb = 0 ; sb < (int)n_bands ; sb++) {
+				arma::uword b = (arma::uword)sb;
+#else
+			for (arma::uword b = 0 ; b < n_bands ; b++) {
+#endif
+				const arma::uword y0 = b * gray_band_rows;
+				const arma::uword rows = std::min(gray_band_rows, n_rows - y0);
+
+				for (arma::uword y = y0 ; y < y0 + rows ; y++)
+					gray_row(src + y * step, buffer->colptr(y), n_cols, cn, w);
+
+				transpose_copy(buffer->colptr(y0), n_cols, dst + y0, n_rows, n_cols, rows);
+#if defined(USE_PPL)
+			});
+#else
+			}
+#endif
+		}
+	}
+
+	/**
+	 *	@brief	Converts an 8-bit row-major color image, such as a decoded frame, to a gray image.
+	 *	@param data		the first pixel
+	 *	@param step		the distance between two rows in bytes, 0 if they are contiguous
+	 *	@param format	the channel order of the pixels
+	 *	@param gray		the gray image, resized to @c width x @c height
+	 *	@note	The weights are those of cv::cvtColor in 14-bit fixed point, so the results are identical.
+	 *			The pixels are deinterleaved and converted with SSE2/AVX2 dispatched at runtime, bands of rows are
+	 *			converted in parallel, and the image is transposed into @c gray in the same pass. OpenCV is not required.
+	 */
+	template <typename pixel_type>
+	void color2gray(const unsigned char* data, arma::uword width, arma::uword height, size_t step, color_format format, Image<pixel_type>& gray)
+	{
+		gray.resize(width, height);
+		if (gray.n_elem == 0) return;
+
+		if (step == 0)
+			step = width * ((format == bgr || format == rgb) ? 3 : 4);
+		detail::color_to_gray_transposed(data, step, format, gray.memptr(), height, width);
+	}
+
+#ifdef USE_OPENCV
+	/**
+	 *	@brief	Convert Image type to the cv::Mat type.
+	 *	@param out	the converted image, which is reallocated only if its size or type differs
+	 *	@note	The image is transposed into the rows of the cv::Mat in a single tiled pass, see detail::transpose_copy.
+	 */
+	template <typename pixel_type>
+	void tocvMat(const Image<pixel_type>& img, cv::Mat& out)
+	{
+		out.create(img.n_rows, img.n_cols, cv::DataType<pixel_type>::type);	// reallocated only if the size or the type differs
+		detail::transpose_copy_parallel(img.memptr(), img.n_rows, (pixel_type*)out.data, out.step1(), img.n_rows, img.n_cols);
+	}
+
+	/**
+	 *	@brief	Convert Image type to the cv::Mat type, see #tocvMat.
+	 *	@return	The converted image.
+	 */
+    template <typename pixel_type>
+	cv::Mat tocvMat(const Image<pixel_type>& img)
+	{
+		cv::Mat out;
+		tocvMat(img, out);
+
+		//cv::imshow(name, out);
+		return out;
+	}
+
+	/**
+	 *	@brief	Convert BGR image or colormap to grayscale.
+	 *	@param img	the truecolor BGR image to be converted into grayscale
+	 *	@param gray	grayscale intensity image, which is reallocated only if its size differs from that of @c img
+	 *	@note	An 8-bit BGR or BGRA image is converted by #color2gray; other images are converted by cv::cvtColor
+	 *			into a pooled buffer, then transposed.
+	 *	@see	http://www.mathworks.co.kr/kr/help/images/ref/rgb2gray.html
+	 */
+	template <typename pixel_type>
+	void bgr2gray(const cv::Mat& img, Image<pixel_type>& gray)
+	{
+		gray.resize(img.cols, img.rows);
+		if (gray.n_elem == 0) return;
+
+		if (img.depth() == CV_8U && (img.channels() == 3 || img.channels() == 4))
+			color2gray(img.data, img.cols, img.rows, img.step, img.channels() == 3 ? bgr : bgra, gray);
+		else {
+			// the columns of the buffer are the rows of the image, so cv::cvtColor writes into it without reallocation
+			pooled_image<pixel_type> buffer(img.rows, img.cols);
+			cv::Mat bw(img.rows, img.cols, cv::DataType<pixel_type>::type, buffer->memptr());
+			cv::cvtColor(img, bw, CV_BGR2GRAY);
+			detail::transpose_copy_parallel((const pixel_type*)bw.data, bw.step1(), gray.memptr(), gray.n_rows, (arma::uword)bw.cols, (arma::uword)bw.rows);
+		}
+	}
+
+	/**
+	 *	@brief	Convert BGR image or colormap to grayscale, see #bgr2gray.
+	 *	@return	grayscale intensity image
+	 */
+    template <typename pixel_type>
+	Image<pixel_type>	bgr2gray(const cv::Mat& img)
+	{
+		Image<pixel_type> gray;
+		bgr2gray(img, gray);
+		return gray;
 	}
 #endif
 }
@@ -37,48 +37,756 @@
  */
 #pragma once
 
+#include "simd_aux.hpp"
+
 namespace auxiliary
 {
-    //! Compute integral
-    template <typename T1, typename T2>
-    void integral(const arma::Mat<T1>& A, arma::Mat<T2>& I)
-    {
-        typedef typename arma::uword size_type;
-        
-        // set size
-        I.set_size(A.n_rows, A.n_cols);
-        
-        // Naive implementation
-        const T1* ptr = A.memptr();
-        T2* iptr = I.memptr();
-        
-        iptr[0] = static_cast<T2>(ptr[0]);
-        
-        // 0-th column
-        for (size_type y = 1 ; y < A.n_rows ; y++)
-            iptr[y] = iptr[y - 1] + static_cast<T2>(ptr[y]);
-        
-        // 0-th row
-        for (size_type x = 1 ; x < A.n_cols ; x++)
-            I.at(0, x) = I.at(0, x - 1) + static_cast<T2>(A.at(0, x));
-        
-        const T2* iptr0 = iptr;
-        for (size_type x = 1 ; x < A.n_cols ; x++) {
-            ptr = A.colptr(x);
-            T2* iptr1 = I.colptr(x);
-            T2 s = 0;
-            for (size_type y = 1 ; y < A.n_rows ; y++) {
-                s += static_cast<T2>(ptr[y]);
-                iptr1[y] = iptr0[y] + s;
-            }
-        }
-    }
-    
+	namespace detail
+	{
+		/// The number of rows handled together in the carry propagation pass of #integral.
+		const arma::uword integral_band_rows = 256;
+
+		/// The width of the skewed column tiles traversed by the tilted #integral.
+		const arma::uword integral_tilted_tile_cols = 32;
+
+		/**
+		 *	@brief	Accumulates the columns [x0, x1) of an image vertically.
+		 *			Each column is independent, so the stripes can be processed in parallel.
+		 *	@param stride	the distance between two columns of @c src; @c src may be @c dst
+		 */
+		template <typename T1, typename T2>
+		inline void integral_columns(const T1* src, arma::uword stride, T2* dst, arma::uword n_rows, arma::uword x0, arma::uword x1)
+		{
+			typedef arma::uword size_type;
+
+			for (size_type x = x0 ; x < x1 ; x++) {
+				const T1* ptr = src + x * stride;
+				T2* iptr = dst + x * n_rows;
+				T2 s = 0;
+				for (size_type y = 0 ; y < n_rows ; y++) {
+					s += static_cast<T2>(ptr[y]);
+					iptr[y] = s;
+				}
+			}
+		}
+
+		/**
+		 *	@brief	Accumulates the rows [y0, y1) of a row-major image horizontally into the column-major @c dst.
+		 *			Each row is independent, so the bands can be processed in parallel.
+		 *	@param stride	the distance between two rows of @c src
+		 */
+		template <typename T1, typename T2>
+		inline void integral_rows(const T1* src, arma::uword stride, T2* dst, arma::uword n_rows, arma::uword n_cols, arma::uword y0, arma::uword y1)
+		{
+			typedef arma::uword size_type;
+
+			for (size_type y = y0 ; y < y1 ; y++) {
+				const T1* ptr = src + y * stride;
+				T2* iptr = dst + y;
+				T2 s = 0;
+				for (size_type x = 0 ; x < n_cols ; x++) {
+					s += static_cast<T2>(ptr[x]);
+					iptr[x * n_rows] = s;
+				}
+			}
+		}
+
+		/**
+		 *	@brief	Accumulates the rows [y, n) of a column and its square vertically, starting from @c s and @c sq.
+		 *			When @c sum0 and @c sqsum0 are given, the previous column of the tables is added as well,
+		 *			so that the column is finished in a single pass.
+		 */
+		template <typename T1, typename T2, typename T3>
+		inline void integral_column_scalar(const T1* src, T2* sum, T3* sqsum, const T2* sum0, const T3* sqsum0, 
+										   arma::uword y, arma::uword n, T2 s, T3 sq)
+		{
+			if (sum0) {
+				for ( ; y < n ; y++) {
+					T2 it = src[y];
+					s += it;
+					sq += (T3)it * it;
+					sum[y] = sum0[y] + s;
+					sqsum[y] = sqsum0[y] + sq;
+				}
+			} else {
+				for ( ; y < n ; y++) {
+					T2 it = src[y];
+					s += it;
+					sq += (T3)it * it;
+					sum[y] = s;
+					sqsum[y] = sq;
+				}
+			}
+		}
+
+		/// Whether @c T is an accumulator type with SIMD kernels
+		template <typename T> struct is_simd_accumulator		{ static const bool value = false; };
+		template <> struct is_simd_accumulator<int>			{ static const bool value = true; };
+		template <> struct is_simd_accumulator<arma::u32>	{ static const bool value = true; };
+		template <> struct is_simd_accumulator<arma::s64>	{ static const bool value = true; };
+		template <> struct is_simd_accumulator<arma::u64>	{ static const bool value = true; };
+		template <> struct is_simd_accumulator<double>		{ static const bool value = true; };
+
+		/**
+		 *	@brief	Whether #integral has SIMD kernels for the pixel type @c T1,
+		 *			the sum type @c T2 and the squared sum type @c T3.
+		 */
+		template <typename T1, typename T2, typename T3>
+		struct integral_simd_traits
+		{
+			static const bool value = false;
+		};
+
+		template <typename T2, typename T3>
+		struct integral_simd_traits<unsigned char, T2, T3>
+		{
+			static const bool value = is_simd_accumulator<T2>::value && is_simd_accumulator<T3>::value;
+		};
+
+		template <typename T2, typename T3>
+		struct integral_simd_traits<unsigned short, T2, T3>
+		{
+			// squares of 16-bit pixels do not fit in 32-bit integers
+			static const bool value = is_simd_accumulator<T2>::value && is_simd_accumulator<T3>::value && sizeof(T3) == 8;
+		};
+
+#if ENABLE_SSE2
+		/// Loads 4 pixels as 32-bit integers.
+		inline __m128i integral_load4(const unsigned char* p)
+		{
+			int v;
+			memcpy(&v, p, sizeof(v));
+			const __m128i z = _mm_setzero_si128();
+			return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), z), z);
+		}
+
+		/// Loads 4 pixels as 32-bit integers.
+		inline __m128i integral_load4(const unsigned short* p)
+		{
+			return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+		}
+
+		/// Inclusive prefix sum of 4 32-bit integers.
+		inline __m128i integral_scan4(__m128i v)
+		{
+			v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+			return _mm_add_epi32(v, _mm_slli_si128(v, 8));
+		}
+
+		/// Running sums of a column held in SSE2 registers.
+		template <typename T>
+		struct integral_acc_sse2;
+
+		template <>
+		struct integral_acc_sse2<int>
+		{
+			__m128i carry;	///< the last running sum in every lane
+
+			integral_acc_sse2() : carry(_mm_setzero_si128()) {}
+
+			/// Stores 4 running sums, given the prefix sums @c p of the block.
+			inline void store(int* dst, const int* prev, __m128i p)
+			{
+				p = _mm_add_epi32(p, carry);
+				carry = _mm_shuffle_epi32(p, 0xFF);
+				if (prev) p = _mm_add_epi32(p, _mm_loadu_si128((const __m128i*)prev));
+				_mm_storeu_si128((__m128i*)dst, p);
+			}
+
+			inline int value() const { return _mm_cvtsi128_si32(carry); }
+		};
+
+		template <>
+		struct integral_acc_sse2<arma::s64>
+		{
+			__m128i carry;	///< the last running sum in every lane
+
+			integral_acc_sse2() : carry(_mm_setzero_si128()) {}
+
+			/// Stores 4 running sums, given the non-negative prefix sums @c p of the block.
+			inline void store(arma::s64* dst, const arma::s64* prev, __m128i p)
+			{
+				const __m128i z = _mm_setzero_si128();
+				store(dst, prev, _mm_unpacklo_epi32(p, z), _mm_unpackhi_epi32(p, z));
+			}
+
+			/// Stores 4 running sums, given the prefix sums of the block in two halves.
+			inline void store(arma::s64* dst, const arma::s64* prev, __m128i lo, __m128i hi)
+			{
+				lo = _mm_add_epi64(lo, carry);
+				hi = _mm_add_epi64(hi, carry);
+				carry = _mm_unpackhi_epi64(hi, hi);
+				if (prev) {
+					lo = _mm_add_epi64(lo, _mm_loadu_si128((const __m128i*)prev));
+					hi = _mm_add_epi64(hi, _mm_loadu_si128((const __m128i*)(prev + 2)));
+				}
+				_mm_storeu_si128((__m128i*)dst, lo);
+				_mm_storeu_si128((__m128i*)(dst + 2), hi);
+			}
+
+			inline arma::s64 value() const
+			{
+				arma::s64 v;
+				_mm_storel_epi64((__m128i*)&v, carry);
+				return v;
+			}
+		};
+
+		template <>
+		struct integral_acc_sse2<double>
+		{
+			__m128d carry;	///< the last running sum in every lane
+
+			integral_acc_sse2() : carry(_mm_setzero_pd()) {}
+
+			/// Stores 4 running sums, given the prefix sums @c p of the block.
+			inline void store(double* dst, const double* prev, __m128i p)
+			{
+				store(dst, prev, _mm_cvtepi32_pd(p), _mm_cvtepi32_pd(_mm_srli_si128(p, 8)));
+			}
+
+			/// Stores 4 running sums, given the prefix sums of the block in two halves.
+			inline void store(double* dst, const double* prev, __m128d lo, __m128d hi)
+			{
+				lo = _mm_add_pd(lo, carry);
+				hi = _mm_add_pd(hi, carry);
+				carry = _mm_unpackhi_pd(hi, hi);
+				if (prev) {
+					lo = _mm_add_pd(_mm_loadu_pd(prev), lo);
+					hi = _mm_add_pd(_mm_loadu_pd(prev + 2), hi);
+				}
+				_mm_storeu_pd(dst, lo);
+				_mm_storeu_pd(dst + 2, hi);
+			}
+
+			inline double value() const { return _mm_cvtsd_f64(carry); }
+		};
+
+		/// Unsigned sums wrap around like the signed ones
+		template <>
+		struct integral_acc_sse2<arma::u32> : integral_acc_sse2<int>
+		{
+			inline void store(arma::u32* dst, const arma::u32* prev, __m128i p)
+			{
+				integral_acc_sse2<int>::store((int*)dst, (const int*)prev, p);
+			}
+
+			inline arma::u32 value() const { return (arma::u32)integral_acc_sse2<int>::value(); }
+		};
+
+		/// Unsigned sums wrap around like the signed ones
+		template <>
+		struct integral_acc_sse2<arma::u64> : integral_acc_sse2<arma::s64>
+		{
+			inline void store(arma::u64* dst, const arma::u64* prev, __m128i p)
+			{
+				integral_acc_sse2<arma::s64>::store((arma::s64*)dst, (const arma::s64*)prev, p);
+			}
+
+			inline void store(arma::u64* dst, const arma::u64* prev, __m128i lo, __m128i hi)
+			{
+				integral_acc_sse2<arma::s64>::store((arma::s64*)dst, (const arma::s64*)prev, lo, hi);
+			}
+
+			inline arma::u64 value() const { return (arma::u64)integral_acc_sse2<arma::s64>::value(); }
+		};
+
+		/// Stores the running squared sums of 4 8-bit pixels.
+		template <typename T>
+		inline void integral_store_sq(integral_acc_sse2<T>& acc, T* dst, const T* prev, __m128i v, const unsigned char*)
+		{
+			acc.store(dst, prev, integral_scan4(_mm_madd_epi16(v, v)));
+		}
+
+		/// Stores the running squared sums of 4 16-bit pixels into 64-bit integers.
+		template <typename T>
+		inline void integral_store_sq(integral_acc_sse2<T>& acc, T* dst, const T* prev, __m128i v, const unsigned short*)
+		{
+			const __m128i o = _mm_srli_epi64(v, 32);
+			const __m128i e2 = _mm_mul_epu32(v, v),	// x0^2, x2^2
+						  o2 = _mm_mul_epu32(o, o);	// x1^2, x3^2
+			__m128i lo = _mm_unpacklo_epi64(e2, o2),
+					hi = _mm_unpackhi_epi64(e2, o2);
+			lo = _mm_add_epi64(lo, _mm_slli_si128(lo, 8));
+			hi = _mm_add_epi64(hi, _mm_slli_si128(hi, 8));
+			hi = _mm_add_epi64(hi, _mm_unpackhi_epi64(lo, lo));
+			acc.store(dst, prev, lo, hi);
+		}
+
+		/// Stores the running squared sums of 4 16-bit pixels.
+		inline void integral_store_sq(integral_acc_sse2<double>& acc, double* dst, const double* prev, __m128i v, const unsigned short*)
+		{
+			// squares are exact in double precision
+			__m128d lo = _mm_cvtepi32_pd(v),
+					hi = _mm_cvtepi32_pd(_mm_srli_si128(v, 8));
+			lo = _mm_mul_pd(lo, lo);
+			hi = _mm_mul_pd(hi, hi);
+			lo = _mm_add_pd(lo, _mm_unpacklo_pd(_mm_setzero_pd(), lo));
+			hi = _mm_add_pd(hi, _mm_unpacklo_pd(_mm_setzero_pd(), hi));
+			hi = _mm_add_pd(hi, _mm_unpackhi_pd(lo, lo));
+			acc.store(dst, prev, lo, hi);
+		}
+
+		/// SSE2 version of #integral_column_scalar.
+		template <typename T1, typename T2, typename T3>
+		void integral_column_sse2(const T1* src, T2* sum, T3* sqsum, const T2* sum0, const T3* sqsum0, arma::uword n)
+		{
+			integral_acc_sse2<T2> s;
+			integral_acc_sse2<T3> sq;
+
+			arma::uword y = 0;
+			for ( ; y + 4 <= n ; y += 4) {
+				const __m128i v = integral_load4(src + y);
+				s.store(sum + y, sum0 ? sum0 + y : 0, integral_scan4(v));
+				integral_store_sq(sq, sqsum + y, sqsum0 ? sqsum0 + y : 0, v, src);
+			}
+
+			integral_column_scalar(src, sum, sqsum, sum0, sqsum0, y, n, s.value(), sq.value());
+		}
+#endif
+
+#if ENABLE_AVX2
+		/// Loads 8 pixels as 32-bit integers.
+		AUX_TARGET_AVX2 inline __m256i integral_load8(const unsigned char* p)
+		{
+			return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p));
+		}
+
+		/// Loads 8 pixels as 32-bit integers.
+		AUX_TARGET_AVX2 inline __m256i integral_load8(const unsigned short* p)
+		{
+			return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p));
+		}
+
+		/// Inclusive prefix sum of 8 32-bit integers.
+		AUX_TARGET_AVX2 inline __m256i integral_scan8(__m256i v)
+		{
+			v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+			v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+			// carry the lower 128-bit lane into the upper one
+			const __m256i t = _mm256_shuffle_epi32(v, 0xFF);
+			return _mm256_add_epi32(v, _mm256_permute2x128_si256(t, t, 0x08));
+		}
+
+		/// Inclusive prefix sum of 4 64-bit integers.
+		AUX_TARGET_AVX2 inline __m256i integral_scan4_epi64(__m256i v)
+		{
+			v = _mm256_add_epi64(v, _mm256_slli_si256(v, 8));
+			const __m256i t = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 1, 1, 1));
+			return _mm256_add_epi64(v, _mm256_blend_epi32(_mm256_setzero_si256(), t, 0xF0));
+		}
+
+		/// Inclusive prefix sum of 4 doubles.
+		AUX_TARGET_AVX2 inline __m256d integral_scan4_pd(__m256d v)
+		{
+			const __m256d z = _mm256_setzero_pd();
+			v = _mm256_add_pd(v, _mm256_blend_pd(_mm256_permute4x64_pd(v, _MM_SHUFFLE(2, 1, 0, 0)), z, 0x1));
+			return _mm256_add_pd(v, _mm256_blend_pd(_mm256_permute4x64_pd(v, _MM_SHUFFLE(1, 0, 0, 0)), z, 0x3));
+		}
+
+		/// Running sums of a column held in AVX2 registers.
+		template <typename T>
+		struct integral_acc_avx2;
+
+		template <>
+		struct integral_acc_avx2<int>
+		{
+			__m256i carry;	///< the last running sum in every lane
+
+			AUX_TARGET_AVX2 integral_acc_avx2() : carry(_mm256_setzero_si256()) {}
+
+			/// Stores 8 running sums, given the prefix sums @c p of the block.
+			AUX_TARGET_AVX2 inline void store(int* dst, const int* prev, __m256i p)
+			{
+				p = _mm256_add_epi32(p, carry);
+				carry = _mm256_permutevar8x32_epi32(p, _mm256_set1_epi32(7));
+				if (prev) p = _mm256_add_epi32(p, _mm256_loadu_si256((const __m256i*)prev));
+				_mm256_storeu_si256((__m256i*)dst, p);
+			}
+
+			AUX_TARGET_AVX2 inline int value() const { return _mm_cvtsi128_si32(_mm256_castsi256_si128(carry)); }
+		};
+
+		template <>
+		struct integral_acc_avx2<arma::s64>
+		{
+			__m256i carry;	///< the last running sum in every lane
+
+			AUX_TARGET_AVX2 integral_acc_avx2() : carry(_mm256_setzero_si256()) {}
+
+			/// Stores 8 running sums, given the non-negative prefix sums @c p of the block.
+			AUX_TARGET_AVX2 inline void store(arma::s64* dst, const arma::s64* prev, __m256i p)
+			{
+				store(dst, prev, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(p)), _mm256_cvtepu32_epi64(_mm256_extracti128_si256(p, 1)));
+			}
+
+			/// Stores 8 running sums, given the prefix sums of the block in two halves.
+			AUX_TARGET_AVX2 inline void store(arma::s64* dst, const arma::s64* prev, __m256i lo, __m256i hi)
+			{
+				lo = _mm256_add_epi64(lo, carry);
+				hi = _mm256_add_epi64(hi, carry);
+				carry = _mm256_permute4x64_epi64(hi, 0xFF);
+				if (prev) {
+					lo = _mm256_add_epi64(lo, _mm256_loadu_si256((const __m256i*)prev));
+					hi = _mm256_add_epi64(hi, _mm256_loadu_si256((const __m256i*)(prev + 4)));
+				}
+				_mm256_storeu_si256((__m256i*)dst, lo);
+				_mm256_storeu_si256((__m256i*)(dst + 4), hi);
+			}
+
+			AUX_TARGET_AVX2 inline arma::s64 value() const
+			{
+				arma::s64 v;
+				_mm_storel_epi64((__m128i*)&v, _mm256_castsi256_si128(carry));
+				return v;
+			}
+		};
+
+		template <>
+		struct integral_acc_avx2<double>
+		{
+			__m256d carry;	///< the last running sum in every lane
+
+			AUX_TARGET_AVX2 integral_acc_avx2() : carry(_mm256_setzero_pd()) {}
+
+			/// Stores 8 running sums, given the prefix sums @c p of the block.
+			AUX_TARGET_AVX2 inline void store(double* dst, const double* prev, __m256i p)
+			{
+				store(dst, prev, _mm256_cvtepi32_pd(_mm256_castsi256_si128(p)), _mm256_cvtepi32_pd(_mm256_extracti128_si256(p, 1)));
+			}
+
+			/// Stores 8 running sums, given the prefix sums of the block in two halves.
+			AUX_TARGET_AVX2 inline void store(double* dst, const double* prev, __m256d lo, __m256d hi)
+			{
+				lo = _mm256_add_pd(lo, carry);
+				hi = _mm256_add_pd(hi, carry);
+				carry = _mm256_permute4x64_pd(hi, 0xFF);
+				if (prev) {
+					lo = _mm256_add_pd(_mm256_loadu_pd(prev), lo);
+					hi = _mm256_add_pd(_mm256_loadu_pd(prev + 4), hi);
+				}
+				_mm256_storeu_pd(dst, lo);
+				_mm256_storeu_pd(dst + 4, hi);
+			}
+
+			AUX_TARGET_AVX2 inline double value() const { return _mm_cvtsd_f64(_mm256_castpd256_pd128(carry)); }
+		};
+
+		/// Unsigned sums wrap around like the signed ones
+		template <>
+		struct integral_acc_avx2<arma::u32> : integral_acc_avx2<int>
+		{
+			AUX_TARGET_AVX2 inline void store(arma::u32* dst, const arma::u32* prev, __m256i p)
+			{
+				integral_acc_avx2<int>::store((int*)dst, (const int*)prev, p);
+			}
+
+			AUX_TARGET_AVX2 inline arma::u32 value() const { return (arma::u32)integral_acc_avx2<int>::value(); }
+		};
+
+		/// Unsigned sums wrap around like the signed ones
+		template <>
+		struct integral_acc_avx2<arma::u64> : integral_acc_avx2<arma::s64>
+		{
+			AUX_TARGET_AVX2 inline void store(arma::u64* dst, const arma::u64* prev, __m256i p)
+			{
+				integral_acc_avx2<arma::s64>::store((arma::s64*)dst, (const arma::s64*)prev, p);
+			}
+
+			AUX_TARGET_AVX2 inline void store(arma::u64* dst, const arma::u64* prev, __m256i lo, __m256i hi)
+			{
+				integral_acc_avx2<arma::s64>::store((arma::s64*)dst, (const arma::s64*)prev, lo, hi);
+			}
+
+			AUX_TARGET_AVX2 inline arma::u64 value() const { return (arma::u64)integral_acc_avx2<arma::s64>::value(); }
+		};
+
+		/// Stores the running squared sums of 8 8-bit pixels.
+		template <typename T>
+		AUX_TARGET_AVX2 inline void integral_store_sq(integral_acc_avx2<T>& acc, T* dst, const T* prev, __m256i v, const unsigned char*)
+		{
+			acc.store(dst, prev, integral_scan8(_mm256_madd_epi16(v, v)));
+		}
+
+		/// Stores the running squared sums of 8 16-bit pixels into 64-bit integers.
+		template <typename T>
+		AUX_TARGET_AVX2 inline void integral_store_sq(integral_acc_avx2<T>& acc, T* dst, const T* prev, __m256i v, const unsigned short*)
+		{
+			const __m256i o = _mm256_srli_epi64(v, 32);
+			const __m256i e2 = _mm256_mul_epu32(v, v),				// x0^2, x2^2 | x4^2, x6^2
+						  o2 = _mm256_mul_epu32(o, o);				// x1^2, x3^2 | x5^2, x7^2
+			const __m256i a = _mm256_unpacklo_epi64(e2, o2),		// x0^2, x1^2 | x4^2, x5^2
+						  b = _mm256_unpackhi_epi64(e2, o2);		// x2^2, x3^2 | x6^2, x7^2
+			__m256i lo = integral_scan4_epi64(_mm256_permute2x128_si256(a, b, 0x20)),
+					hi = integral_scan4_epi64(_mm256_permute2x128_si256(a, b, 0x31));
+			hi = _mm256_add_epi64(hi, _mm256_permute4x64_epi64(lo, 0xFF));
+			acc.store(dst, prev, lo, hi);
+		}
+
+		/// Stores the running squared sums of 8 16-bit pixels.
+		AUX_TARGET_AVX2 inline void integral_store_sq(integral_acc_avx2<double>& acc, double* dst, const double* prev, __m256i v, const unsigned short*)
+		{
+			// squares are exact in double precision
+			__m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v)),
+					hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+			lo = integral_scan4_pd(_mm256_mul_pd(lo, lo));
+			hi = integral_scan4_pd(_mm256_mul_pd(hi, hi));
+			hi = _mm256_add_pd(hi, _mm256_permute4x64_pd(lo, 0xFF));
+			acc.store(dst, prev, lo, hi);
+		}
+
+		/// AVX2 version of #integral_column_scalar.
+		template <typename T1, typename T2, typename T3>
+		AUX_TARGET_AVX2 void integral_column_avx2(const T1* src, T2* sum, T3* sqsum, const T2* sum0, const T3* sqsum0, arma::uword n)
+		{
+			integral_acc_avx2<T2> s;
+			integral_acc_avx2<T3> sq;
+
+			arma::uword y = 0;
+			for ( ; y + 8 <= n ; y += 8) {
+				const __m256i v = integral_load8(src + y);
+				s.store(sum + y, sum0 ? sum0 + y : 0, integral_scan8(v));
+				integral_store_sq(sq, sqsum + y, sqsum0 ? sqsum0 + y : 0, v, src);
+			}
+
+			integral_column_scalar(src, sum, sqsum, sum0, sqsum0, y, n, s.value(), sq.value());
+		}
+#endif
+
+		/// Selects the kernel of #integral_column at compile time.
+		template <bool vectorized>
+		struct integral_column_dispatch
+		{
+			template <typename T1, typename T2, typename T3>
+			static void run(const T1* src, T2* sum, T3* sqsum, const T2* sum0, const T3* sqsum0, arma::uword n)
+			{
+				integral_column_scalar(src, sum, sqsum, sum0, sqsum0, 0, n, T2(0), T3(0));
+			}
+		};
+
+		template <>
+		struct integral_column_dispatch<true>
+		{
+			template <typename T1, typename T2, typename T3>
+			static void run(const T1* src, T2* sum, T3* sqsum, const T2* sum0, const T3* sqsum0, arma::uword n)
+			{
+				// and the instruction set at runtime
+#if ENABLE_AVX2
+				if (simd_support() == simd_avx2)
+					return integral_column_avx2(src, sum, sqsum, sum0, sqsum0, n);
+#endif
+#if ENABLE_SSE2
+				if (simd_support() >= simd_sse2)
+					return integral_column_sse2(src, sum, sqsum, sum0, sqsum0, n);
+#endif
+				integral_column_scalar(src, sum, sqsum, sum0, sqsum0, 0, n, T2(0), T3(0));
+			}
+		};
+
+		/**
+		 *	@brief	Accumulates a column of @c n pixels and its square vertically,
+		 *			adding the previous column of the tables when @c sum0 and @c sqsum0 are given.
+		 *			SSE2/AVX2 kernels are used for 8-bit and 16-bit pixels when they are enabled.
+		 */
+		template <typename T1, typename T2, typename T3>
+		inline void integral_column(const T1* src, T2* sum, T3* sqsum, const T2* sum0, const T3* sqsum0, arma::uword n)
+		{
+			integral_column_dispatch<integral_simd_traits<T1, T2, T3>::value>::run(src, sum, sqsum, sum0, sqsum0, n);
+		}
+
+		/// Accumulates the columns [x0, x1) of an image and its square vertically.
+		template <typename T1, typename T2, typename T3>
+		inline void integral_columns(const T1* src, T2* dst, T3* sqdst, arma::uword n_rows, arma::uword x0, arma::uword x1)
+		{
+			for (arma::uword x = x0 ; x < x1 ; x++)
+				integral_column(src + x * n_rows, dst + x * n_rows, sqdst + x * n_rows, (const T2*)0, (const T3*)0, n_rows);
+		}
+
+		/**
+		 *	@brief	Propagates the column sums horizontally for the rows [y0, y1).
+		 *			Rows are independent, and a band of rows of adjacent columns stays in cache.
+		 */
+		template <typename T>
+		inline void integral_carry(T* ptr, arma::uword n_rows, arma::uword n_cols, arma::uword y0, arma::uword y1)
+		{
+			typedef arma::uword size_type;
+
+			const T* ptr0 = ptr + y0;
+			for (size_type x = 1 ; x < n_cols ; x++) {
+				T* ptr1 = ptr + x * n_rows + y0;
+				for (size_type y = 0 ; y < y1 - y0 ; y++)
+					ptr1[y] = ptr0[y] + ptr1[y];
+				ptr0 = ptr1;
+			}
+		}
+
+		/// Runs #integral_carry over all rows, one band of #integral_band_rows rows per task.
+		template <typename T>
+		void integral_carry(T* ptr, arma::uword n_rows, arma::uword n_cols)
+		{
+			typedef arma::uword size_type;
+
+			const size_type n_bands = (n_rows + integral_band_rows - 1) / integral_band_rows;
+#if defined(USE_PPL)
+			concurrency::parallel_for(size_type(0), n_bands, [&](size_type b) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+			for (int sb = 0 ; sb < (int)n_bands ; sb++) {
+				size_type b = (size_type)sb;
+#else
+			for (size_type b = 0 ; b < n_bands ; b++) {
+#endif
+				const size_type y0 = b * integral_band_rows;
+				integral_carry(ptr, n_rows, n_cols, y0, std::min(y0 + integral_band_rows, n_rows));
+#if defined(USE_PPL)
+			});
+#else
+			}
+#endif
+		}
+
+		/// The number of columns handled by a task of the column pass.
+		inline arma::uword integral_stripe_cols(arma::uword n_rows)
+		{
+			// about 64K pixels per stripe, at least one column
+			return std::max<arma::uword>(1, (1 << 16) / std::max<arma::uword>(1, n_rows));
+		}
+	}
+
+	namespace detail
+	{
+		/**
+		 *	@brief	Computes the integral of a column-major image, see #integral.
+		 *	@param stride	the distance between two columns of @c ptr
+		 */
+		template <typename T1, typename T2>
+		void integral_table(const T1* ptr, arma::uword stride, T2* iptr, arma::uword n_rows, arma::uword n_cols)
+		{
+			typedef typename arma::uword size_type;
+
+			const size_type stripe = integral_stripe_cols(n_rows);
+			const size_type n_stripes = (n_cols + stripe - 1) / stripe;
+
+			// vertical prefix sums, stripe by stripe
+#if defined(USE_PPL)
+			concurrency::parallel_for(size_type(0), n_stripes, [&](size_type s) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+			for (int ss = 0 ; ss < (int)n_stripes ; ss++) {
+				size_type s = (size_type)ss;
+#else
+			for (size_type s = 0 ; s < n_stripes ; s++) {
+#endif
+				integral_columns(ptr, stride, iptr, n_rows, s * stripe, std::min((s + 1) * stripe, n_cols));
+#if defined(USE_PPL)
+			});
+#else
+			}
+#endif
+
+			// horizontal carry propagation
+			integral_carry(iptr, n_rows, n_cols);
+		}
+
+		/**
+		 *	@brief	Computes the integral of a row-major image, see #integral.<br>
+		 *			The rows are accumulated first in parallel bands, then the columns of the table in parallel stripes.
+		 *	@param stride	the distance between two rows of @c ptr
+		 */
+		template <typename T1, typename T2>
+		void integral_table_rows(const T1* ptr, arma::uword stride, T2* iptr, arma::uword n_rows, arma::uword n_cols)
+		{
+			typedef typename arma::uword size_type;
+
+			const size_type n_bands = (n_rows + integral_band_rows - 1) / integral_band_rows;
+			const size_type stripe = integral_stripe_cols(n_rows);
+			const size_type n_stripes = (n_cols + stripe - 1) / stripe;
+
+			// horizontal prefix sums, band by band
+#if defined(USE_PPL)
+			concurrency::parallel_for(size_type(0), n_bands, [&](size_type b) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+			for (int sb = 0 ; sb < (int)n_bands ; sb++) {
+				size_type b = (size_type)sb;
+#else
+			for (size_type b = 0 ; b < n_bands ; b++) {
+#endif
+				integral_rows(ptr, stride, iptr, n_rows, n_cols, b * integral_band_rows, std::min((b + 1) * integral_band_rows, n_rows));
+#if defined(USE_PPL)
+			});
+#else
+			}
+#endif
+
+			// vertical prefix sums of the row sums in place
+#if defined(USE_PPL)
+			concurrency::parallel_for(size_type(0), n_stripes, [&](size_type s) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+			for (int ss = 0 ; ss < (int)n_stripes ; ss++) {
+				size_type s = (size_type)ss;
+#else
+			for (size_type s = 0 ; s < n_stripes ; s++) {
+#endif
+				integral_columns(iptr, n_rows, iptr, n_rows, s * stripe, std::min((s + 1) * stripe, n_cols));
+#if defined(USE_PPL)
+			});
+#else
+			}
+#endif
+		}
+	}
+
+	/**
+	 *	@brief	Compute integral
+	 *	@param [in] A	input matrix
+	 *	@param [out] I	integral image, @f$ I(y, x) = \sum_{y' \le y, x' \le x} A(y', x') @f$
+	 *	@note	The image is split into column stripes whose vertical prefix sums are computed in parallel,
+	 *			then the horizontal carry is propagated in parallel over bands of rows.
+	 *			The summation order is the same as the sequential scan, so the results are bit-identical.
+	 */
+	template <typename T1, typename T2>
+	void integral(const arma::Mat<T1>& A, arma::Mat<T2>& I)
+	{
+		// set size
+		I.set_size(A.n_rows, A.n_cols);
+
+		if (A.n_elem == 0) return;
+
+		detail::integral_table(A.memptr(), A.n_rows, I.memptr(), A.n_rows, A.n_cols);
+	}
+
+	/**
+	 *	@brief	Compute integral of a view
+	 *	@param [in] A	input view, of which columns or rows may be padded
+	 *	@param [out] I	integral image, see the #integral of a matrix
+	 *	@note	A ::row_major view is accumulated along its rows first, so the table is computed without transposing the view.
+	 *			The floating point sums of a ::row_major view may thus differ from those of its copy in the last bits.
+	 */
+	template <typename T1, typename T2>
+	void integral(const image_view<T1>& A, arma::Mat<T2>& I)
+	{
+		// set size
+		I.set_size(A.n_rows, A.n_cols);
+
+		if (A.n_elem == 0) return;
+
+		if (A.layout() == col_major)
+			detail::integral_table(A.memptr(), A.stride(), I.memptr(), A.n_rows, A.n_cols);
+		else
+			detail::integral_table_rows(A.memptr(), A.stride(), I.memptr(), A.n_rows, A.n_cols);
+	}
+
 	/**
 	 *	@brief	Compute integral images
 	 *	@param [in] img		input image
 	 *	@param [out] sum	integral image
 	 *	@param [out] sqsum	squared integral image
+	 *	@note	Parallelized in the same way as the two-argument #integral with bit-identical results.
+	 *			Without parallelism, both tables are computed in a single streaming pass.
+	 *			SSE2/AVX2 kernels are dispatched at runtime for 8-bit pixels with @c int, @c s64 or @c double tables,
+	 *			and for 16-bit pixels with @c int, @c s64 or @c double sums and @c s64 or @c double squared sums.
 	*/
 	template <typename T1, typename T2, typename T3>
 	void integral(const Image<T1>& img, Image<T2>& sum, Image<T3>& sqsum)
@@ -89,57 +797,840 @@ namespace auxiliary
 		sum.resize(img.width(), img.height());
 		sqsum.resize(img.width(), img.height());
 
-		// simplest implementation
+		if (img.n_elem == 0) return;
+
 		const T1* ptr = img.memptr();
 		T2* sumptr = sum.memptr();
 		T3* sqsumptr = sqsum.memptr();
 
-		T2 s = 0;
-		T3 sq = 0;
+		// image is column major
+		const size_type n_rows = img.height();
+
+#if defined(USE_PPL) || defined(USE_OPENMP)
+		// each column is accumulated independently
+		const size_type stripe = detail::integral_stripe_cols(n_rows);
+		const size_type n_stripes = (img.width() + stripe - 1) / stripe;
 
-		// image is column major,
-		// 0-th column accumulated
-		for (size_type y = 0 ; y < img.height() ; y++) {
-			const T1 it = ptr[y];
-			s += it;
-			sq += (T3)it * it;
-			sumptr[y] = s;
-			sqsumptr[y] = sq;
+#if defined(USE_PPL)
+		concurrency::parallel_for(size_type(0), n_stripes, [&](size_type s) {
+#else
+	#pragma omp parallel for
+		for (int ss = 0 ; ss < (int)n_stripes ; ss++) {
+			size_type s = (size_type)ss;
+#endif
+			detail::integral_columns(ptr, sumptr, sqsumptr, n_rows, s * stripe, std::min((s + 1) * stripe, img.width()));
+#if defined(USE_PPL)
+		});
+#else
 		}
+#endif
+
+		// then accumulated along the rows
+		detail::integral_carry(sumptr, n_rows, img.width());
+		detail::integral_carry(sqsumptr, n_rows, img.width());
+#else
+		// a single streaming pass, each column is accumulated and added to the previous one
+		detail::integral_column(ptr, sumptr, sqsumptr, (const T2*)0, (const T3*)0, n_rows);
+		for (size_type x = 1 ; x < img.width() ; x++)
+			detail::integral_column(ptr + x * n_rows, sumptr + x * n_rows, sqsumptr + x * n_rows,
+									sumptr + (x - 1) * n_rows, sqsumptr + (x - 1) * n_rows, n_rows);
+#endif
+	}
+
+	/**
+	 *	@brief	Compute integral images including the 45 degree rotated one
+	 *	@param [in] img		input image
+	 *	@param [out] sum	integral image, of size width x height and not padded
+	 *	@param [out] sqsum	squared integral image, of size width x height and not padded
+	 *	@param [out] tilted	integral of the image rotated by 45 degrees, of size (width + 1) x (height + 1).
+	 *						Unlike @c sum and @c sqsum, it keeps the leading zero row and column of OpenCV,
+	 *						since the apex of a tilted area may lie left of the image, so that
+	 *						tilted(Y + 1, X + 1) is aligned with sum(Y, X), and
+	 *						\f[
+	 *							tilted(Y, X) = \sum_{y < Y, |x - X + 1| \le Y - y - 1} img(y, x)
+	 *						\f]
+	 *	@note	The tilted table depends on both neighbors in the row above, so the image is traversed row by row
+	 *			inside column tiles skewed by one column per row; each tile only depends on the tiles to its left,
+	 *			and the three tables are computed together in a single traversal. @c sum and @c sqsum are identical
+	 *			to those of the three-argument #integral.
+	 *	@see	integral in sumpixels.cpp of OpenCV
+	 */
+	template <typename T1, typename T2, typename T3>
+	void integral(const Image<T1>& img, Image<T2>& sum, Image<T3>& sqsum, Image<T2>& tilted)
+	{
+		typedef typename Image<T1>::size_type	size_type;
 
-		s = sumptr[0];
-		sq = sqsumptr[0];
-		// 0-th row accumulated
-		for (size_type x = 1 ; x < img.width() ; x++) {
-			T2 it = img(0, x);
-			s += it;
-			sq += (T3)it * it;
-			sum.at(0, x) = s;
-			sqsum.at(0, x) = sq;
+		// allocate images
+		sum.resize(img.width(), img.height());
+		sqsum.resize(img.width(), img.height());
+		tilted.resize(img.width() + 1, img.height() + 1);
+
+		if (img.n_elem == 0) {
+			tilted.zeros();
+			return;
+		}
+
+		const int W = (int)img.width(), H = (int)img.height();
+		const int B = (int)detail::integral_tilted_tile_cols;
+		const size_type tstep = H + 1;
+
+		const T1* ptr = img.memptr();
+		T2* sumptr = sum.memptr();
+		T3* sqsumptr = sqsum.memptr();
+		T2* tptr = tilted.memptr();
+
+		// the first row of tilted is zero
+		for (int X = 0 ; X <= W ; X++)
+			tptr[X * tstep] = 0;
+
+		// running column sums
+		std::vector<T2> cs(W, T2(0));
+		std::vector<T3> csq(W, T3(0));
+
+		// tile t covers the columns [t * B - Y, (t + 1) * B - Y) of the row Y of tilted
+		const int n_tiles = (W + H) / B + 1;
+		for (int t = 0 ; t < n_tiles ; t++) {
+			for (int Y = 1 ; Y <= H ; Y++) {
+				const int X0 = std::max(0, t * B - Y), X1 = std::min(W + 1, (t + 1) * B - Y);
+				const int y = Y - 1;
+
+				for (int X = X0 ; X < X1 ; X++) {
+					T2* tcol = tptr + X * tstep;
+
+					if (X == 0) {
+						// the apex lies left of the image, tilted(Y, 0) equals to tilted(Y - 1, 1)
+						tcol[Y] = tptr[tstep + Y - 1];
+						continue;
+					}
+
+					const int x = X - 1;
+					const T1* src = ptr + x * H;
+
+					// upright tables, in the same summation order as the column pass
+					T2 it = src[y];
+					cs[x] += it;
+					csq[x] += (T3)it * it;
+					sumptr[x * H + y] = x ? sumptr[(x - 1) * H + y] + cs[x] : cs[x];
+					sqsumptr[x * H + y] = x ? sqsumptr[(x - 1) * H + y] + csq[x] : csq[x];
+
+					// tilted(Y, X) = tilted(Y - 1, X - 1) + tilted(Y - 1, X + 1) - tilted(Y - 2, X) + img(Y - 1, X - 1) + img(Y - 2, X - 1)
+					T2 v = tcol[Y - tstep - 1] + it;
+					if (Y > 1) {
+						// the apex lies right of the image, tilted(Y - 1, W + 1) equals to tilted(Y - 2, W)
+						v += (X < W) ? tcol[Y + tstep - 1] : tcol[Y - 2];
+						v += (T2)src[y - 1] - tcol[Y - 2];
+					} else if (X < W)
+						v += tcol[Y + tstep - 1];
+					tcol[Y] = v;
+				}
+			}
+		}
+	}
+
+	namespace detail
+	{
+		/// Reads a table entry, where a negative index denotes the zero row or column left of or above the image.
+		template <typename T>
+		inline T box_lookup(const T* table, int i)
+		{
+			return (i < 0) ? T(0) : table[i];
+		}
+
+		/// Table indices of the corners above-left, above-right, below-left and below-right of the box, negative outside the table.
+		inline void box_corners(const Rect<int>& r, int n_rows, int* i)
+		{
+			const int x0 = r.x() - 1, y0 = r.y() - 1;
+			const int x1 = x0 + r.width(), y1 = y0 + r.height();
+			i[0] = (x0 < 0 || y0 < 0) ? -1 : x0 * n_rows + y0;
+			i[1] = (y0 < 0) ? -1 : x1 * n_rows + y0;
+			i[2] = (x0 < 0) ? -1 : x0 * n_rows + y1;
+			i[3] = x1 * n_rows + y1;
+		}
+
+		/// Sum over the box of the given corners of an integral table.
+		template <typename T>
+		inline T box_corner_sum(const T* table, const int* i)
+		{
+			return box_lookup(table, i[3]) - box_lookup(table, i[1]) - box_lookup(table, i[2]) + box_lookup(table, i[0]);
+		}
+
+		/**
+		 *	@brief	Computes the box sums out[j] = table[i11[j]] - table[i01[j]] - table[i10[j]] + table[i00[j]].
+		 *			Negative indices read as zero.
+		 */
+		template <typename T>
+		inline void box_sums_scalar(const T* table, const int* i00, const int* i01, const int* i10, const int* i11, T* out, arma::uword j, arma::uword n)
+		{
+			for ( ; j < n ; j++)
+				out[j] = box_lookup(table, i11[j]) - box_lookup(table, i01[j]) - box_lookup(table, i10[j]) + box_lookup(table, i00[j]);
+		}
+
+#if ENABLE_AVX2
+		/// Gathers 8 entries of the table, negative indices read as zero.
+		AUX_TARGET_AVX2 inline __m256i box_gather8(const int* table, const int* idx)
+		{
+			const __m256i i = _mm256_loadu_si256((const __m256i*)idx);
+			const __m256i mask = _mm256_cmpgt_epi32(i, _mm256_set1_epi32(-1));
+			return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), table, i, mask, sizeof(int));
+		}
+
+		/// Gathers 4 entries of the table, negative indices read as zero.
+		AUX_TARGET_AVX2 inline __m256d box_gather4(const double* table, const int* idx)
+		{
+			const __m128i i = _mm_loadu_si128((const __m128i*)idx);
+			const __m256d mask = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpgt_epi32(i, _mm_set1_epi32(-1))));
+			return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), table, i, mask, sizeof(double));
+		}
+
+		/// AVX2 version of #box_sums_scalar.
+		AUX_TARGET_AVX2 inline void box_sums_avx2(const int* table, const int* i00, const int* i01, const int* i10, const int* i11, int* out, arma::uword n)
+		{
+			arma::uword j = 0;
+			for ( ; j + 8 <= n ; j += 8) {
+				__m256i s = _mm256_sub_epi32(box_gather8(table, i11 + j), box_gather8(table, i01 + j));
+				s = _mm256_add_epi32(_mm256_sub_epi32(s, box_gather8(table, i10 + j)), box_gather8(table, i00 + j));
+				_mm256_storeu_si256((__m256i*)(out + j), s);
+			}
+			box_sums_scalar(table, i00, i01, i10, i11, out, j, n);
+		}
+
+		/// AVX2 version of #box_sums_scalar.
+		AUX_TARGET_AVX2 inline void box_sums_avx2(const double* table, const int* i00, const int* i01, const int* i10, const int* i11, double* out, arma::uword n)
+		{
+			arma::uword j = 0;
+			for ( ; j + 4 <= n ; j += 4) {
+				__m256d s = _mm256_sub_pd(box_gather4(table, i11 + j), box_gather4(table, i01 + j));
+				s = _mm256_add_pd(_mm256_sub_pd(s, box_gather4(table, i10 + j)), box_gather4(table, i00 + j));
+				_mm256_storeu_pd(out + j, s);
+			}
+			box_sums_scalar(table, i00, i01, i10, i11, out, j, n);
+		}
+#endif
+
+		/// Computes the box sums with the best available kernel.
+		template <typename T>
+		struct box_sums_dispatch
+		{
+			static void run(const T* table, const int* i00, const int* i01, const int* i10, const int* i11, T* out, arma::uword n)
+			{
+				box_sums_scalar(table, i00, i01, i10, i11, out, 0, n);
+			}
+		};
+
+		template <>
+		struct box_sums_dispatch<int>
+		{
+			static void run(const int* table, const int* i00, const int* i01, const int* i10, const int* i11, int* out, arma::uword n)
+			{
+#if ENABLE_AVX2
+				if (simd_support() == simd_avx2)
+					return box_sums_avx2(table, i00, i01, i10, i11, out, n);
+#endif
+				box_sums_scalar(table, i00, i01, i10, i11, out, 0, n);
+			}
+		};
+
+		template <>
+		struct box_sums_dispatch<arma::u32>
+		{
+			static void run(const arma::u32* table, const int* i00, const int* i01, const int* i10, const int* i11, arma::u32* out, arma::uword n)
+			{
+				// unsigned differences wrap around like the signed ones
+				box_sums_dispatch<int>::run((const int*)table, i00, i01, i10, i11, (int*)out, n);
+			}
+		};
+
+		template <>
+		struct box_sums_dispatch<double>
+		{
+			static void run(const double* table, const int* i00, const int* i01, const int* i10, const int* i11, double* out, arma::uword n)
+			{
+#if ENABLE_AVX2
+				if (simd_support() == simd_avx2)
+					return box_sums_avx2(table, i00, i01, i10, i11, out, n);
+#endif
+				box_sums_scalar(table, i00, i01, i10, i11, out, 0, n);
+			}
+		};
+	}
+
+	/**
+	 *	@brief	Constant-time rectangle queries over the tables of #integral.
+	 *			It hides the four-corner lookup, including the first row and column
+	 *			which the tables do not pad with zeros.
+	 *			Batched queries reuse internal buffers and gather the corners with AVX2 when available.
+	 *	@tparam	T2	the type of the integral image
+	 *	@tparam	T3	the type of the squared integral image
+	 *	@note	The tables are referenced, not copied. Rectangles must be non-empty and inside the image.
+	 *			Only the unpadded @c sum and @c sqsum tables are supported; the @c tilted table of the
+	 *			four-argument #integral is offset by one row and one column and cannot be queried.
+	 */
+	template <typename T2, typename T3 = double>
+	class box_query
+	{
+	public:
+		typedef arma::uword		size_type;
+		typedef Rect<int>		rect_type;	///< x, y, width and height of a box
+
+		/// Constructor
+		explicit box_query(const Image<T2>& sum)
+			: sum_(sum.memptr()), sqsum_(0), n_rows_((int)sum.n_rows) {}
+
+		/// Constructor
+		box_query(const Image<T2>& sum, const Image<T3>& sqsum)
+			: sum_(sum.memptr()), sqsum_(sqsum.memptr()), n_rows_((int)sum.n_rows)
+		{
+			assert(sum.n_rows == sqsum.n_rows && sum.n_cols == sqsum.n_cols);
+		}
+
+		/// Sum of the pixels in the box
+		inline T2 box_sum(const rect_type& r) const
+		{
+			int i[4];
+			detail::box_corners(r, n_rows_, i);
+			return detail::box_corner_sum(sum_, i);
+		}
+
+		/// Sum of the squared pixels in the box
+		inline T3 box_sqsum(const rect_type& r) const
+		{
+			assert(sqsum_ != 0);
+			int i[4];
+			detail::box_corners(r, n_rows_, i);
+			return detail::box_corner_sum(sqsum_, i);
+		}
+
+		/// Mean of the pixels in the box
+		inline double box_mean(const rect_type& r) const
+		{
+			return (double)box_sum(r) / r.area();
+		}
+
+		/// Variance of the pixels in the box
+		inline double box_variance(const rect_type& r) const
+		{
+			const double n = (double)r.area();
+			const double m = (double)box_sum(r) / n;
+			return (double)box_sqsum(r) / n - m * m;
+		}
+
+		/// Sums of the pixels in the boxes
+		void box_sum(const std::vector<rect_type>& rects, std::vector<T2>& out)
+		{
+			set_corners(rects);
+			out.resize(rects.size());
+			if (!rects.empty()) sums(sum_, &out[0]);
+		}
+
+		/// Sums of the squared pixels in the boxes
+		void box_sqsum(const std::vector<rect_type>& rects, std::vector<T3>& out)
+		{
+			assert(sqsum_ != 0);
+			set_corners(rects);
+			out.resize(rects.size());
+			if (!rects.empty()) sums(sqsum_, &out[0]);
+		}
+
+		/// Means of the pixels in the boxes
+		void box_mean(const std::vector<rect_type>& rects, std::vector<double>& out)
+		{
+			box_sum(rects, s_);
+			out.resize(rects.size());
+			for (size_type j = 0 ; j < rects.size() ; j++)
+				out[j] = (double)s_[j] / rects[j].area();
+		}
+
+		/// Variances of the pixels in the boxes
+		void box_variance(const std::vector<rect_type>& rects, std::vector<double>& out)
+		{
+			assert(sqsum_ != 0);
+			set_corners(rects);
+			s_.resize(rects.size());
+			sq_.resize(rects.size());
+			out.resize(rects.size());
+			if (rects.empty()) return;
+
+			sums(sum_, &s_[0]);
+			sums(sqsum_, &sq_[0]);
+			for (size_type j = 0 ; j < rects.size() ; j++) {
+				const double n = (double)rects[j].area();
+				const double m = (double)s_[j] / n;
+				out[j] = (double)sq_[j] / n - m * m;
+			}
+		}
+
+	private:
+		/// Stores the corners of the boxes as four index arrays.
+		void set_corners(const std::vector<rect_type>& rects)
+		{
+			const size_type n = rects.size();
+			idx_.resize(4 * n);
+			for (size_type j = 0 ; j < n ; j++) {
+				int i[4];
+				detail::box_corners(rects[j], n_rows_, i);
+				idx_[j]			= i[0];
+				idx_[n + j]		= i[1];
+				idx_[2 * n + j]	= i[2];
+				idx_[3 * n + j]	= i[3];
+			}
+		}
+
+		/// Computes the box sums over the table for the stored corners.
+		template <typename T>
+		void sums(const T* table, T* out) const
+		{
+			const size_type n = idx_.size() / 4;
+			const int* i = &idx_[0];
+			detail::box_sums_dispatch<T>::run(table, i, i + n, i + 2 * n, i + 3 * n, out, n);
+		}
+
+	private:
+		const T2*			sum_;		///< the integral image
+		const T3*			sqsum_;		///< the squared integral image
+		int					n_rows_;	///< the height of the tables
+
+		std::vector<int>	idx_;		///< the corner indices of the last batch
+		std::vector<T2>		s_;			///< the box sums of the last batch
+		std::vector<T3>		sq_;		///< the squared box sums of the last batch
+	};
+
+	/**
+	 *	@brief	Integral images of an image growing row by row, e.g. from a line-scan camera.
+	 *			Pushing a row costs O(width) however many rows have been accumulated,
+	 *			and without a window the tables are identical to those of #integral over all the rows pushed so far.
+	 *	@tparam	T1	the pixel type
+	 *	@tparam	T2	the type of the integral image
+	 *	@tparam	T3	the type of the squared integral image
+	 *	@note	With a window, only the rows of the last @c window scanlines are kept in a #circular_buffer,
+	 *			so the memory and the amortized cost per scanline are constant. Otherwise all rows are kept.
+	 *			The kept rows are rebased every @c window scanlines by subtracting the oldest of them, so that the entries
+	 *			sum at most 2 x @c window scanlines and an endless stream does not overflow; the box sums are unchanged,
+	 *			but #sum_at and #sqsum_at are relative to a recent row then, including the row above the image
+	 *			which is kept, for the boxes from the first row, until the first rebase.
+	 */
+	template <typename T1, typename T2, typename T3 = double>
+	class integral_stream
+	{
+	public:
+		typedef arma::uword		size_type;
+		typedef Rect<arma::sword>	rect_type;	///< x, y, width and height of a box, which can address as many rows as #size_type
+
+		/**
+		 *	@brief	Constructor
+		 *	@param width	the width of the image
+		 *	@param window	the number of rows to keep, or zero to keep all rows
+		 */
+		explicit integral_stream(size_type width, size_type window = 0)
+			: width_(width), window_(window), rows_(0), unbased_(0),
+			  colsum_(width, T2(0)), colsqsum_(width, T3(0)),
+			  above_sum_(window > 0 ? width : 0, T2(0)), above_sqsum_(window > 0 ? width : 0, T3(0)),
+			  sum_window_(std::max<size_type>(window, 1)), sqsum_window_(std::max<size_type>(window, 1))
+		{
+			// rows above the image are zero
+			for (size_type i = 0 ; i < window_ ; i++) {
+				sum_window_.push_back(arma::zeros<arma::Col<T2> >(width_));
+				sqsum_window_.push_back(arma::zeros<arma::Col<T3> >(width_));
+			}
 		}
 
-		T2* sptr0 = sum.colptr(0);
-		T3* sqptr0 = sqsum.colptr(0);
+		/// Discards all rows, keeping the allocated storage.
+		void reset()
+		{
+			rows_ = 0;
+			unbased_ = 0;
+			std::fill(colsum_.begin(), colsum_.end(), T2(0));
+			std::fill(colsqsum_.begin(), colsqsum_.end(), T3(0));
+			std::fill(above_sum_.begin(), above_sum_.end(), T2(0));
+			std::fill(above_sqsum_.begin(), above_sqsum_.end(), T3(0));
+			sum_.clear();
+			sqsum_.clear();
 
-		for (size_type x = 1 ; x < img.width() ; x++) {
+			for (size_type i = 0 ; i < window_ ; i++) {
+				sum_window_[i].zeros();
+				sqsum_window_[i].zeros();
+			}
+		}
+
+		/**
+		 *	@brief	Appends a scanline.
+		 *	@param row		the first pixel of the scanline
+		 *	@param stride	the distance between adjacent pixels of the scanline
+		 */
+		void push_back(const T1* row, size_type stride = 1)
+		{
+			T2* sptr;
+			T3* sqptr;
+
+			if (window_ > 0) {
+				// reuse the storage of the oldest row
+				sptr = sum_window_.next().memptr();
+				sqptr = sqsum_window_.next().memptr();
+			} else {
+				sum_.resize(sum_.size() + width_);
+				sqsum_.resize(sqsum_.size() + width_);
+				sptr = &sum_[rows_ * width_];
+				sqptr = &sqsum_[rows_ * width_];
+			}
+
+			// same recurrence as #integral, sum(y, x) = sum(y, x - 1) + column sum
 			T2 s = 0;
 			T3 sq = 0;
-			
-			T2* sptr1 = sum.colptr(x);
-			T3* sqptr1 = sqsum.colptr(x);
+			for (size_type x = 0 ; x < width_ ; x++) {
+				T2 it = row[x * stride];
+				colsum_[x] += it;
+				colsqsum_[x] += (T3)it * it;
+				s = x ? s + colsum_[x] : colsum_[x];
+				sq = x ? sq + colsqsum_[x] : colsqsum_[x];
+				sptr[x] = s;
+				sqptr[x] = sq;
+			}
+
+			++rows_;
+			if (window_ > 0 && ++unbased_ == window_)
+				rebase();
+		}
+
+		/// Appends the rows of a strip of scanlines.
+		void push_back(const arma::Mat<T1>& strip)
+		{
+			assert(strip.n_cols == width_);
+			for (size_type y = 0 ; y < strip.n_rows ; y++)
+				push_back(strip.memptr() + y, strip.n_rows);
+		}
+
+		/// Get the number of rows pushed so far
+		inline size_type rows() const { return rows_; }
+
+		/// Get the image width
+		inline size_type width() const { return width_; }
+
+		/// Get the first row of which table entries are still kept
+		inline size_type first_row() const { return (window_ > 0 && rows_ > window_) ? rows_ - window_ : 0; }
+
+		/// Get the entry of the integral image, zero above or left of the image; relative to a recent row with a window
+		inline T2 sum_at(arma::sword y, arma::sword x) const
+		{
+			if (x < 0) return T2(0);
+			return (y < 0) ? above(above_sum_, x) : row(sum_, sum_window_, (size_type)y)[x];
+		}
+
+		/// Get the entry of the squared integral image, zero above or left of the image; relative to a recent row with a window
+		inline T3 sqsum_at(arma::sword y, arma::sword x) const
+		{
+			if (x < 0) return T3(0);
+			return (y < 0) ? above(above_sqsum_, x) : row(sqsum_, sqsum_window_, (size_type)y)[x];
+		}
+
+		/// Sum of the pixels in the box, of which the row above must be kept
+		template <typename T>
+		inline T2 box_sum(const Rect<T>& r) const
+		{
+			const arma::sword x0 = (arma::sword)r.x() - 1, y0 = (arma::sword)r.y() - 1, x1 = x0 + r.width(), y1 = y0 + r.height();
+			return sum_at(y1, x1) - sum_at(y0, x1) - sum_at(y1, x0) + sum_at(y0, x0);
+		}
+
+		/// Sum of the squared pixels in the box, of which the row above must be kept
+		template <typename T>
+		inline T3 box_sqsum(const Rect<T>& r) const
+		{
+			const arma::sword x0 = (arma::sword)r.x() - 1, y0 = (arma::sword)r.y() - 1, x1 = x0 + r.width(), y1 = y0 + r.height();
+			return sqsum_at(y1, x1) - sqsum_at(y0, x1) - sqsum_at(y1, x0) + sqsum_at(y0, x0);
+		}
 
-			for (size_type y = 0 ; y < img.height() ; y++) {
-				T2 it = img(y, x);
-				s += it;
-				sq += (T3)it * it;
-				//sum.at(y, x) = sum.at(y, x - 1) + s;
-				sptr1[y] = sptr0[y] + s;
-				//sqsum.at(y, x) = sqsum.at(y, x - 1) + sq;
-				sqptr1[y] = sqptr0[y] + sq;
+		/// Mean of the pixels in the box
+		template <typename T>
+		inline double box_mean(const Rect<T>& r) const
+		{
+			return (double)box_sum(r) / r.area();
+		}
+
+		/// Variance of the pixels in the box
+		template <typename T>
+		inline double box_variance(const Rect<T>& r) const
+		{
+			const double n = (double)r.area();
+			const double m = (double)box_sum(r) / n;
+			return (double)box_sqsum(r) / n - m * m;
+		}
+
+	private:
+		/**
+		 *	@brief	Subtracts the oldest kept row from all kept rows and its column sums from the running ones.<br>
+		 *			Every entry of a row loses the same prefix of column sums, so the differences of rows and the box sums are kept.
+		 */
+		void rebase()
+		{
+			unbased_ = 0;
+
+			const T2* s0 = sum_window_[0].memptr();
+			const T3* sq0 = sqsum_window_[0].memptr();
+			for (size_type x = 0 ; x < width_ ; x++) {
+				colsum_[x] -= x ? s0[x] - s0[x - 1] : s0[x];
+				colsqsum_[x] -= x ? sq0[x] - sq0[x - 1] : sq0[x];
 			}
 
-			sptr0 = sptr1;
-			sqptr0 = sqptr1;
+			// the row above the image is kept until the first rebase only, and becomes the negated oldest row
+			if (rows_ == window_) {
+				for (size_type x = 0 ; x < width_ ; x++) {
+					above_sum_[x] = T2(0) - s0[x];
+					above_sqsum_[x] = T3(0) - sq0[x];
+				}
+			}
+
+			// the oldest row last, since it is subtracted
+			for (size_type i = window_ ; i-- > 0 ; ) {
+				T2* s = sum_window_[i].memptr();
+				T3* sq = sqsum_window_[i].memptr();
+				for (size_type x = 0 ; x < width_ ; x++) {
+					s[x] -= s0[x];
+					sq[x] -= sq0[x];
+				}
+			}
+		}
+
+		/// Get an entry of the row above the image, which is zero until the first #rebase
+		template <typename T>
+		inline T above(const std::vector<T>& entries, arma::sword x) const
+		{
+			if (window_ == 0)
+				return T(0);
+
+			assert(rows_ <= window_);
+			return entries[x];
 		}
+
+		/// Get a row of a table
+		template <typename T>
+		inline const T* row(const std::vector<T>& all, const circular_buffer<arma::Col<T> >& recent, size_type y) const
+		{
+			assert(y < rows_);
+			if (window_ == 0)
+				return &all[y * width_];
+
+			// the last row is the newest
+			assert(y + window_ >= rows_);
+			return recent[y + window_ - rows_].memptr();
+		}
+
+	private:
+		size_type							width_;			///< the image width
+		size_type							window_;		///< the number of rows kept, zero for all
+		size_type							rows_;			///< the number of rows pushed so far
+		size_type							unbased_;		///< the number of rows pushed since the last #rebase
+
+		std::vector<T2>						colsum_;		///< the running column sums
+		std::vector<T3>						colsqsum_;		///< the running squared column sums
+		std::vector<T2>						above_sum_;		///< the row of the integral image above the image, with a window
+		std::vector<T3>						above_sqsum_;	///< the row of the squared integral image above the image, with a window
+
+		std::vector<T2>						sum_;			///< all rows of the integral image, row by row
+		std::vector<T3>						sqsum_;			///< all rows of the squared integral image, row by row
+		circular_buffer<arma::Col<T2> >		sum_window_;	///< the last rows of the integral image
+		circular_buffer<arma::Col<T3> >		sqsum_window_;	///< the last rows of the squared integral image
+	};
+
+	/**
+	 *	@brief	Accumulator types of #integral for the pixel type @c T1.
+	 *			@c sum_type and @c sqsum_type are the narrowest unsigned types which are overflow-free
+	 *			for images of up to #max_sum_pixels and #max_sqsum_pixels pixels respectively,
+	 *			@c wide_sum_type and @c wide_sqsum_type are used for larger images.
+	 *			Floating point pixels are accumulated in double precision.
+	 */
+	template <typename T1>
+	struct integral_traits
+	{
+		typedef double		sum_type;			///< the narrow type of the integral image
+		typedef double		sqsum_type;			///< the narrow type of the squared integral image
+		typedef double		wide_sum_type;		///< the type of the integral image of large images
+		typedef double		wide_sqsum_type;	///< the type of the squared integral image of large images
+
+		static const arma::u64 max_sum_pixels = ~arma::u64(0);		///< the largest image for @c sum_type
+		static const arma::u64 max_sqsum_pixels = ~arma::u64(0);	///< the largest image for @c sqsum_type
+	};
+
+	template <>
+	struct integral_traits<unsigned char>
+	{
+		typedef arma::u32	sum_type;
+		typedef arma::u64	sqsum_type;
+		typedef arma::u64	wide_sum_type;
+		typedef arma::u64	wide_sqsum_type;
+
+		static const arma::u64 max_sum_pixels = 0xFFFFFFFFull / 255;					// 16.8M pixels
+		static const arma::u64 max_sqsum_pixels = 0xFFFFFFFFFFFFFFFFull / (255 * 255);
+	};
+
+	/// A 32-bit sum would only be exact up to 256 x 256 pixels, so 16-bit images are always accumulated in 64 bits,
+	/// and only the squared sums of images beyond 4G pixels fall back to double precision.
+	template <>
+	struct integral_traits<unsigned short>
+	{
+		typedef arma::u64	sum_type;
+		typedef arma::u64	sqsum_type;
+		typedef arma::u64	wide_sum_type;
+		typedef double		wide_sqsum_type;
+
+		static const arma::u64 max_sum_pixels = 0xFFFFFFFFFFFFFFFFull / 65535;
+		static const arma::u64 max_sqsum_pixels = 0xFFFFFFFFFFFFFFFFull / (65535ull * 65535);	// 4G pixels
+	};
+
+	/**
+	 *	@brief	Integral images with overflow-free accumulators of the least width.
+	 *			The narrow types of #integral_traits are used when the image is small enough for them,
+	 *			otherwise the wide types are used. The tables are reused across frames of the same size.
+	 *	@tparam	T1	the pixel type
+	 */
+	template <typename T1>
+	class integral_tables
+	{
+	public:
+		typedef integral_traits<T1>						traits;
+		typedef typename traits::sum_type				sum_type;
+		typedef typename traits::sqsum_type				sqsum_type;
+		typedef typename traits::wide_sum_type			wide_sum_type;
+		typedef typename traits::wide_sqsum_type		wide_sqsum_type;
+		typedef Rect<int>								rect_type;	///< x, y, width and height of a box
+
+		/// Constructor
+		integral_tables() : wide_(false) {}
+
+		/// Computes the tables of the image.
+		void compute(const Image<T1>& img)
+		{
+			const arma::u64 n = img.n_elem;
+			wide_ = n > traits::max_sum_pixels || n > traits::max_sqsum_pixels;
+
+			if (wide_) {
+				integral(img, wsum_, wsqsum_);
+				sum_.reset();
+				sqsum_.reset();
+			} else {
+				integral(img, sum_, sqsum_);
+				wsum_.reset();
+				wsqsum_.reset();
+			}
+		}
+
+		/// Whether the wide tables are in use
+		inline bool wide() const { return wide_; }
+
+		/// Get the narrow integral image, valid unless #wide
+		inline const Image<sum_type>& sum() const { return sum_; }
+
+		/// Get the narrow squared integral image, valid unless #wide
+		inline const Image<sqsum_type>& sqsum() const { return sqsum_; }
+
+		/// Get the wide integral image, valid if #wide
+		inline const Image<wide_sum_type>& wide_sum() const { return wsum_; }
+
+		/// Get the wide squared integral image, valid if #wide
+		inline const Image<wide_sqsum_type>& wide_sqsum() const { return wsqsum_; }
+
+		/// Sum of the pixels in the box
+		inline wide_sum_type box_sum(const rect_type& r) const
+		{
+			int i[4];
+			if (wide_) {
+				detail::box_corners(r, (int)wsum_.n_rows, i);
+				return detail::box_corner_sum(wsum_.memptr(), i);
+			}
+			detail::box_corners(r, (int)sum_.n_rows, i);
+			return (wide_sum_type)detail::box_corner_sum(sum_.memptr(), i);
+		}
+
+		/// Sum of the squared pixels in the box
+		inline wide_sqsum_type box_sqsum(const rect_type& r) const
+		{
+			int i[4];
+			if (wide_) {
+				detail::box_corners(r, (int)wsqsum_.n_rows, i);
+				return detail::box_corner_sum(wsqsum_.memptr(), i);
+			}
+			detail::box_corners(r, (int)sqsum_.n_rows, i);
+			return (wide_sqsum_type)detail::box_corner_sum(sqsum_.memptr(), i);
+		}
+
+		/// Mean of the pixels in the box
+		inline double box_mean(const rect_type& r) const
+		{
+			return (double)box_sum(r) / r.area();
+		}
+
+		/// Variance of the pixels in the box
+		inline double box_variance(const rect_type& r) const
+		{
+			const double n = (double)r.area();
+			const double m = (double)box_sum(r) / n;
+			return (double)box_sqsum(r) / n - m * m;
+		}
+
+	private:
+		bool						wide_;		///< whether the wide tables are in use
+		Image<sum_type>				sum_;		///< the narrow integral image
+		Image<sqsum_type>			sqsum_;		///< the narrow squared integral image
+		Image<wide_sum_type>		wsum_;		///< the wide integral image
+		Image<wide_sqsum_type>		wsqsum_;	///< the wide squared integral image
+	};
+
+	/**
+	 *	@brief	Box filter of which cost per pixel is independent of the box size, computed from the integral image.
+	 *	@param	img		An input image.
+	 *	@param	ksize	The size of the box, placed around each pixel as a kernel of the same size by #blur.
+	 *	@return	The mean of the pixels in the box around each pixel.
+	 *			Near the borders, only the pixels inside the image are averaged.
+	 *	@note	The integral image is accumulated in the wide type of #integral_traits, so it never overflows.
+	 *			It lives here rather than beside #blur since it is built on #integral, and integral.hpp depends on imgproc_aux.hpp.
+	 */
+	template <typename T1>
+	Image<T1> boxFilter(const Image<T1>& img, const Size<arma::uword>& ksize)
+	{
+		typedef typename integral_traits<T1>::wide_sum_type	sum_type;
+		typedef arma::uword size_type;
+
+		assert(ksize.width() > 0 && ksize.height() > 0);
+
+		Image<T1> out(img.n_cols, img.n_rows);
+		if (img.n_elem == 0) return out;
+
+		pooled_image<sum_type> buffer(img.n_cols, img.n_rows);
+		arma::Mat<sum_type>& sum = *buffer;
+		integral(img, sum);
+
+		// the box of the pixel (y, x) spans [y - ay, y + by] x [x - ax, x + bx]
+		const int by = (int)ksize.height() / 2, ay = (int)ksize.height() - 1 - by;
+		const int bx = (int)ksize.width() / 2, ax = (int)ksize.width() - 1 - bx;
+		const int n_rows = (int)img.n_rows, n_cols = (int)img.n_cols;
+
+#if defined(USE_PPL)
+		concurrency::parallel_for(size_type(0), (size_type)img.n_cols, [&](size_type x) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for
+		for (int sx = 0 ; sx < n_cols ; sx++) {
+			size_type x = (size_type)sx;
+#else
+		for (size_type x = 0 ; x < img.n_cols ; x++) {
+#endif
+			const int x0 = std::max((int)x - ax, 0), x1 = std::min((int)x + bx, n_cols - 1);
+			const sum_type* right = sum.colptr(x1);
+			const sum_type* left = (x0 > 0) ? sum.colptr(x0 - 1) : NULL;
+			T1* dst = out.colptr(x);
+
+			for (int y = 0 ; y < n_rows ; y++) {
+				const int y0 = std::max(y - ay, 0), y1 = std::min(y + by, n_rows - 1);
+				sum_type s = right[y1];
+				if (y0 > 0) s -= right[y0 - 1];
+				if (left) {
+					s -= left[y1];
+					if (y0 > 0) s += left[y0 - 1];
+				}
+				dst[y] = arma_ext::saturate_cast<T1>((double)s / ((x1 - x0 + 1) * (y1 - y0 + 1)));
+			}
+#if defined(USE_PPL)
+		});
+#else
+		}
+#endif
+
+		return out;
 	}
 }
\ No newline at end of file
@@ -39,6 +39,8 @@
 
 #include <armadillo>
 
+#include "simd_aux.hpp"
+
 namespace auxiliary
 {
 	/// Various border types, image boundaries are denoted with '|'
@@ -89,7 +91,7 @@ namespace auxiliary
 		case warp:
 			if (p < 0)
 				p -= ((p - n + 1) / n) * n;
-			if (p > n)
+			if (p >= n)
 				p %= n;
 			break;
 		case constant:
@@ -103,6 +105,391 @@ namespace auxiliary
 	}
 
 #define castOp(x) ((x + 128) >> 8)
+#define castOpUp(x) ((x + 32) >> 6)
+
+	namespace detail
+	{
+		/// A compile-time assertion, @c sizeof(static_check<false>) does not compile.
+		template <bool condition> struct static_check;
+		template <> struct static_check<true> {};
+
+		/// The number of output columns of a band processed by a task of #pyrDown.
+		const arma::uword pyramid_band_cols = 64;
+
+		/// Vertical convolution and decimation with SIMD; the generic version does nothing.
+		template <typename T>
+		inline arma::uword pyr_down_vertical_simd(const T*, int*, arma::uword y, arma::uword, arma::uword) { return y; }
+
+		/// Horizontal convolution and decimation with SIMD; the generic version does nothing.
+		template <typename T>
+		inline arma::uword pyr_down_horizontal_simd(const int*, const int*, const int*, const int*, const int*, T*, arma::uword y, arma::uword) { return y; }
+
+#if ENABLE_SSE2
+		/// Loads 8 pixels as 16-bit integers.
+		inline __m128i pyr_load8(const unsigned char* p)
+		{
+			return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+		}
+
+		/// Loads 8 pixels as 16-bit integers.
+		inline __m128i pyr_load8(const unsigned short* p)
+		{
+			return _mm_loadu_si128((const __m128i*)p);
+		}
+
+		/**
+		 *	@brief	SSE2 vertical pass for the rows [y, y1) of a column of @c n_in pixels.
+		 *			Even and odd pixels are split into 32-bit lanes of the same load.
+		 *	@return	the first row which is not processed
+		 */
+		template <typename T>
+		inline arma::uword pyr_down_vertical_sse2(const T* src, int* dst, arma::uword y, arma::uword y1, arma::uword n_in)
+		{
+			const __m128i mask = _mm_set1_epi32(0xFFFF);
+
+			// reads src[2y - 2, 2y + 10)
+			for ( ; y + 4 <= y1 && y * 2 + 10 <= n_in ; y += 4) {
+				const __m128i a = pyr_load8(src + y * 2 - 2),
+							  b = pyr_load8(src + y * 2),
+							  c = pyr_load8(src + y * 2 + 2);
+				const __m128i r0 = _mm_and_si128(a, mask), r1 = _mm_srli_epi32(a, 16),	// src[2y - 2], src[2y - 1]
+							  r2 = _mm_and_si128(b, mask), r3 = _mm_srli_epi32(b, 16),	// src[2y], src[2y + 1]
+							  r4 = _mm_and_si128(c, mask);								// src[2y + 2]
+				__m128i s = _mm_add_epi32(r0, r4);
+				s = _mm_add_epi32(s, _mm_slli_epi32(_mm_add_epi32(r1, r3), 2));
+				s = _mm_add_epi32(s, _mm_add_epi32(_mm_slli_epi32(r2, 2), _mm_slli_epi32(r2, 1)));
+				_mm_storeu_si128((__m128i*)(dst + y), s);
+			}
+
+			return y;
+		}
+
+		/// Horizontal convolution of 4 rows followed by #castOp.
+		inline __m128i pyr_down_horizontal4(const int* col0, const int* col1, const int* col2, const int* col3, const int* col4)
+		{
+			const __m128i c2 = _mm_loadu_si128((const __m128i*)col2);
+			__m128i s = _mm_add_epi32(_mm_loadu_si128((const __m128i*)col0), _mm_loadu_si128((const __m128i*)col4));
+			s = _mm_add_epi32(s, _mm_slli_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i*)col1), _mm_loadu_si128((const __m128i*)col3)), 2));
+			s = _mm_add_epi32(s, _mm_add_epi32(_mm_slli_epi32(c2, 2), _mm_slli_epi32(c2, 1)));
+			return _mm_srai_epi32(_mm_add_epi32(s, _mm_set1_epi32(128)), 8);
+		}
+
+		/// Stores 8 results, which are in the range of the pixel type.
+		inline void pyr_store8(unsigned char* dst, __m128i lo, __m128i hi)
+		{
+			const __m128i p = _mm_packs_epi32(lo, hi);
+			_mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(p, p));
+		}
+
+		/// Stores 8 results, which are in the range of the pixel type.
+		inline void pyr_store8(unsigned short* dst, __m128i lo, __m128i hi)
+		{
+			// SSE2 lacks an unsigned 32-bit pack, so bias into the signed range
+			const __m128i bias = _mm_set1_epi32(32768);
+			const __m128i p = _mm_packs_epi32(_mm_sub_epi32(lo, bias), _mm_sub_epi32(hi, bias));
+			_mm_storeu_si128((__m128i*)dst, _mm_xor_si128(p, _mm_set1_epi16((short)0x8000)));
+		}
+
+		/// SSE2 horizontal pass for the rows [y, y1).
+		template <typename T>
+		inline arma::uword pyr_down_horizontal_sse2(const int* col0, const int* col1, const int* col2, const int* col3, const int* col4, 
+													T* dst, arma::uword y, arma::uword y1)
+		{
+			for ( ; y + 8 <= y1 ; y += 8)
+				pyr_store8(dst + y, pyr_down_horizontal4(col0 + y, col1 + y, col2 + y, col3 + y, col4 + y),
+									pyr_down_horizontal4(col0 + y + 4, col1 + y + 4, col2 + y + 4, col3 + y + 4, col4 + y + 4));
+			return y;
+		}
+#endif
+
+#if ENABLE_AVX2
+		/// Loads 16 pixels as 16-bit integers.
+		AUX_TARGET_AVX2 inline __m256i pyr_load16(const unsigned char* p)
+		{
+			return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+		}
+
+		/// Loads 16 pixels as 16-bit integers.
+		AUX_TARGET_AVX2 inline __m256i pyr_load16(const unsigned short* p)
+		{
+			return _mm256_loadu_si256((const __m256i*)p);
+		}
+
+		/// AVX2 version of #pyr_down_vertical_sse2.
+		template <typename T>
+		AUX_TARGET_AVX2 inline arma::uword pyr_down_vertical_avx2(const T* src, int* dst, arma::uword y, arma::uword y1, arma::uword n_in)
+		{
+			const __m256i mask = _mm256_set1_epi32(0xFFFF);
+
+			// reads src[2y - 2, 2y + 18)
+			for ( ; y + 8 <= y1 && y * 2 + 18 <= n_in ; y += 8) {
+				const __m256i a = pyr_load16(src + y * 2 - 2),
+							  b = pyr_load16(src + y * 2),
+							  c = pyr_load16(src + y * 2 + 2);
+				const __m256i r0 = _mm256_and_si256(a, mask), r1 = _mm256_srli_epi32(a, 16),
+							  r2 = _mm256_and_si256(b, mask), r3 = _mm256_srli_epi32(b, 16),
+							  r4 = _mm256_and_si256(c, mask);
+				__m256i s = _mm256_add_epi32(r0, r4);
+				s = _mm256_add_epi32(s, _mm256_slli_epi32(_mm256_add_epi32(r1, r3), 2));
+				s = _mm256_add_epi32(s, _mm256_add_epi32(_mm256_slli_epi32(r2, 2), _mm256_slli_epi32(r2, 1)));
+				_mm256_storeu_si256((__m256i*)(dst + y), s);
+			}
+
+			return y;
+		}
+
+		/// Stores 8 results, which are in the range of the pixel type.
+		AUX_TARGET_AVX2 inline void pyr_store8_avx2(unsigned char* dst, __m256i v)
+		{
+			const __m128i p = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+			_mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(p, p));
+		}
+
+		/// Stores 8 results, which are in the range of the pixel type.
+		AUX_TARGET_AVX2 inline void pyr_store8_avx2(unsigned short* dst, __m256i v)
+		{
+			_mm_storeu_si128((__m128i*)dst, _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+		}
+
+		/// AVX2 version of #pyr_down_horizontal_sse2.
+		template <typename T>
+		AUX_TARGET_AVX2 inline arma::uword pyr_down_horizontal_avx2(const int* col0, const int* col1, const int* col2, const int* col3, const int* col4, 
+																	T* dst, arma::uword y, arma::uword y1)
+		{
+			for ( ; y + 8 <= y1 ; y += 8) {
+				const __m256i c2 = _mm256_loadu_si256((const __m256i*)(col2 + y));
+				__m256i s = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(col0 + y)), _mm256_loadu_si256((const __m256i*)(col4 + y)));
+				s = _mm256_add_epi32(s, _mm256_slli_epi32(_mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(col1 + y)), _mm256_loadu_si256((const __m256i*)(col3 + y))), 2));
+				s = _mm256_add_epi32(s, _mm256_add_epi32(_mm256_slli_epi32(c2, 2), _mm256_slli_epi32(c2, 1)));
+				pyr_store8_avx2(dst + y, _mm256_srai_epi32(_mm256_add_epi32(s, _mm256_set1_epi32(128)), 8));
+			}
+			return y;
+		}
+#endif
+
+#if ENABLE_SSE2
+		/// Vertical convolution and decimation of 8-bit pixels.
+		inline arma::uword pyr_down_vertical_simd(const unsigned char* src, int* dst, arma::uword y, arma::uword y1, arma::uword n_in)
+		{
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				y = pyr_down_vertical_avx2(src, dst, y, y1, n_in);
+#endif
+			return (simd_support() >= simd_sse2) ? pyr_down_vertical_sse2(src, dst, y, y1, n_in) : y;
+		}
+
+		/// Vertical convolution and decimation of 16-bit pixels.
+		inline arma::uword pyr_down_vertical_simd(const unsigned short* src, int* dst, arma::uword y, arma::uword y1, arma::uword n_in)
+		{
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				y = pyr_down_vertical_avx2(src, dst, y, y1, n_in);
+#endif
+			return (simd_support() >= simd_sse2) ? pyr_down_vertical_sse2(src, dst, y, y1, n_in) : y;
+		}
+
+		/// Horizontal convolution and decimation into 8-bit pixels.
+		inline arma::uword pyr_down_horizontal_simd(const int* col0, const int* col1, const int* col2, const int* col3, const int* col4, 
+													unsigned char* dst, arma::uword y, arma::uword y1)
+		{
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				return pyr_down_horizontal_avx2(col0, col1, col2, col3, col4, dst, y, y1);
+#endif
+			return (simd_support() >= simd_sse2) ? pyr_down_horizontal_sse2(col0, col1, col2, col3, col4, dst, y, y1) : y;
+		}
+
+		/// Horizontal convolution and decimation into 16-bit pixels.
+		inline arma::uword pyr_down_horizontal_simd(const int* col0, const int* col1, const int* col2, const int* col3, const int* col4, 
+													unsigned short* dst, arma::uword y, arma::uword y1)
+		{
+#if ENABLE_AVX2
+			if (simd_support() == simd_avx2)
+				return pyr_down_horizontal_avx2(col0, col1, col2, col3, col4, dst, y, y1);
+#endif
+			return (simd_support() >= simd_sse2) ? pyr_down_horizontal_sse2(col0, col1, col2, col3, col4, dst, y, y1) : y;
+		}
+#endif
+
+		/**
+		 *	@brief	Border tables of #pyrDown for both axes.<br>
+		 *			The pixels outside of the image are looked up in the tables, so the inner loops do not branch.
+		 *			A constant pixel is read from any row with the weight 0, and its weighted value is added instead.
+		 */
+		struct pyr_down_border
+		{
+			arma::umat	rows;		///< the interpolated rows of the top and bottom outputs, 5 x 2
+			arma::imat	weights;	///< the kernel weights of the interpolated rows, 0 for constant pixels
+			arma::ivec	offsets;	///< the weighted sums of the constant pixels of the top and bottom outputs
+			arma::uvec	cols;		///< the interpolated columns from -2 to 2 n_out, or -1 for constant columns
+			int			value;		///< the vertical sum of a constant column
+
+			/**
+			 *	@brief	Builds the tables.
+			 *	@param in_rows, in_cols		the size of the input
+			 *	@param out_rows, out_cols	the size of the output
+			 *	@param border	the border type other than ::transparent
+			 *	@param c		the value of the pixels outside of the image for ::constant
+			 */
+			void create(arma::uword in_rows, arma::uword in_cols, arma::uword out_rows, arma::uword out_cols, border_type border, int c)
+			{
+				const uword KERNEL_SIZE = 5;
+				const int kernel[KERNEL_SIZE] = { 1, 4, 6, 4, 1 };
+				const int sx0 = -(int)KERNEL_SIZE / 2;
+
+				assert(border != transparent);
+
+				rows.set_size(KERNEL_SIZE, 2);
+				weights.set_size(KERNEL_SIZE, 2);
+				offsets.zeros(2);
+				for (uword y = 0 ; y < KERNEL_SIZE ; y++) {
+					const int p[2] = { (int)y + sx0, (int)(y + (out_rows - 1) * 2) + sx0 };
+					for (uword i = 0 ; i < 2 ; i++) {
+						const uword r = borderInterpolate(p[i], (int)in_rows, border);
+						const bool outside = (r >= in_rows);
+						rows(y, i) = outside ? 0 : r;
+						weights(y, i) = outside ? 0 : kernel[y];
+						offsets(i) += outside ? kernel[y] * c : 0;
+					}
+				}
+
+				cols.set_size(out_cols * 2 + 3);
+				for (uword x = 0 ; x < cols.n_elem ; x++)
+					cols(x) = borderInterpolate((int)x + sx0, (int)in_cols, border);
+
+				value = c * 16;
+			}
+		};
+
+		/**
+		 *	@brief	Vertical convolution and decimation of a column.
+		 *	@param src		the input column of @c n_in pixels
+		 *	@param dst		the output column of @c n_out sums
+		 *	@param tab		the border tables
+		 */
+		template <typename T>
+		inline void pyr_down_vertical(const T* src, int* dst, arma::uword n_out, arma::uword n_in, const pyr_down_border& tab)
+		{
+			const uword* lptr = tab.rows.colptr(0), * rptr = tab.rows.colptr(1);
+			const int* lw = tab.weights.colptr(0), * rw = tab.weights.colptr(1);
+
+			dst[0] = src[lptr[0]] * lw[0] + src[lptr[1]] * lw[1] + src[lptr[2]] * lw[2] + src[lptr[3]] * lw[3] + src[lptr[4]] * lw[4] + tab.offsets[0];
+
+			arma::uword y = 1;
+			if (n_out > 2)
+				y = pyr_down_vertical_simd(src, dst, y, n_out - 1, n_in);
+
+			for ( ; y < n_out - 1 ; y++)
+				dst[y] = src[y * 2] * 6 + 
+						 (src[y * 2 - 1] + src[y * 2 + 1]) * 4 + 
+						 (src[y * 2 - 2] + src[y * 2 + 2]);
+
+			dst[n_out - 1] = src[rptr[0]] * rw[0] + src[rptr[1]] * rw[1] + src[rptr[2]] * rw[2] + src[rptr[3]] * rw[3] + src[rptr[4]] * rw[4] + tab.offsets[1];
+		}
+
+		/// Horizontal convolution and decimation of five columns.
+		template <typename T>
+		inline void pyr_down_horizontal(const int* col0, const int* col1, const int* col2, const int* col3, const int* col4, T* dst, arma::uword n_out)
+		{
+			arma::uword y = pyr_down_horizontal_simd(col0, col1, col2, col3, col4, dst, 0, n_out);
+
+			for ( ; y < n_out ; y++)
+				dst[y] = (T)castOp(col2[y] * 6 + (col1[y] + col3[y]) * 4 + col0[y] + col4[y]);
+		}
+
+		/// Fills a ring with the five columns of @c n sums used by #pyr_down_column.
+		inline void pyr_down_ring(circular_buffer<arma::Col<int> >& cols, arma::uword n)
+		{
+			const uword KERNEL_SIZE = 5;
+
+#ifdef __VXWORKS__
+			arma::Col<int> dummy(n); dummy.zeros();
+#endif
+			for (arma::uword i = 0 ; i < KERNEL_SIZE ; i++)
+#ifdef __VXWORKS__
+				cols.push_back(dummy);
+#else
+				cols.push_back(zeros<arma::Col<int> >(n));
+#endif
+		}
+
+		/**
+		 *	@brief	Blurs and downsamples the output column @c x.
+		 *	@param sx	the next input column to convolve vertically, advanced up to 2 x + 3
+		 *	@param tab	the border tables
+		 *	@param cols	the ring of the five last vertically convolved columns
+		 */
+		template <typename T1, typename T2>
+		inline void pyr_down_column(const T1& in, T2& out, arma::uword x, int& sx, const pyr_down_border& tab, circular_buffer<arma::Col<int> >& cols)
+		{
+			// vertical convolution and decimation
+			for ( ; sx <= (int)x * 2 + 2 ; sx++) {
+				// interpolate border
+				const arma::uword c = tab.cols[sx + 2];
+				if (c < in.n_cols)
+					pyr_down_vertical(in.colptr(c), cols.next().memptr(), out.n_rows, in.n_rows, tab);
+				else
+					cols.next().fill(tab.value);
+			}
+
+			// horizontal convolution and decimation
+			pyr_down_horizontal(cols[0].memptr(), cols[1].memptr(), cols[2].memptr(), cols[3].memptr(), cols[4].memptr(), out.colptr(x), out.n_rows);
+		}
+
+		/**
+		 *	@brief	Blurs and downsamples the output columns [x0, x1).
+		 *			Bands are independent; a band recomputes the vertical pass of two columns left of it.
+		 */
+		template <typename T1, typename T2>
+		void pyr_down_band(const T1& in, T2& out, arma::uword x0, arma::uword x1, const pyr_down_border& tab, circular_buffer<arma::Col<int> >& cols)
+		{
+			int sx = (int)x0 * 2 - 2;
+
+			for (arma::uword x = x0 ; x < x1 ; x++)
+				pyr_down_column(in, out, x, sx, tab, cols);
+		}
+
+		/**
+		 *	@brief	Blurs and downsamples the whole image, in parallel bands if enabled.
+		 *	@param rings	the rings of the bands, allocated by each band if @c NULL
+		 */
+		template <typename T1, typename T2>
+		void pyr_down_bands(const T1& in, T2& out, const pyr_down_border& tab, circular_buffer<arma::Col<int> >* rings)
+		{
+#if defined(USE_PPL) || defined(USE_OPENMP)
+			const uword n_bands = (out.n_cols + pyramid_band_cols - 1) / pyramid_band_cols;
+#if defined(USE_PPL)
+			concurrency::parallel_for(uword(0), n_bands, [&](uword b) {
+#else
+	#pragma omp parallel for
+			for (int sb = 0 ; sb < (int)n_bands ; sb++) {
+				uword b = (uword)sb;
+#endif
+				const uword x0 = b * pyramid_band_cols;
+				const uword x1 = std::min(x0 + pyramid_band_cols, (uword)out.n_cols);
+				if (rings)
+					pyr_down_band(in, out, x0, x1, tab, rings[b]);
+				else {
+					circular_buffer<arma::Col<int> > cols(5);
+					pyr_down_ring(cols, out.n_rows);
+					pyr_down_band(in, out, x0, x1, tab, cols);
+				}
+#if defined(USE_PPL)
+			});
+#else
+			}
+#endif
+#else
+			if (rings)
+				pyr_down_band(in, out, 0, out.n_cols, tab, rings[0]);
+			else {
+				circular_buffer<arma::Col<int> > cols(5);
+				pyr_down_ring(cols, out.n_rows);
+				pyr_down_band(in, out, 0, out.n_cols, tab, cols);
+			}
+#endif
+		}
+	}
 
 	/**
 	 *	@brief	Blurs an image and downsamples it.<br>
@@ -119,98 +506,649 @@ namespace auxiliary
 	 *				\end{bmatrix}
 	 *			\f]
 	 *			Then, it downsamples the image by rejecting even rows and columns.
-	 *	@param in
-	 *	@param out
-	 *	@note	This function is preliminary; it is not yet fully optimized.
+	 *	@param in	the source image
+	 *	@param out	the destination image, of which size has to be set
+	 *	@param value	the value of the pixels outside of the image for the ::constant border
+	 *	@tparam	border	the border type; ::transparent is not supported since the kernel needs every pixel.
+	 *	@note	The border pixels are looked up in tables computed once per call.
+	 *			Both passes are vectorized with SSE2/AVX2 for 8-bit and 16-bit pixels, and the output columns
+	 *			are split into bands processed in parallel when @c USE_PPL or @c USE_OPENMP is defined.
+	 *			The results are bit-exact to the scalar code.
 	 *	@see	PyrDownVec_32s8u in pyramid.cpp of OpenCV
 	 */
+	template <border_type border, typename T1, typename T2>
+	void pyrDown(const T1& in, T2& out, typename T1::elem_type value = 0)
+	{
+		(void)sizeof(detail::static_check<border != transparent>);	// the border is not supported
+
+		if (out.n_elem == 0) return;
+
+		detail::pyr_down_border tab;
+		tab.create(in.n_rows, in.n_cols, out.n_rows, out.n_cols, border, (int)value);
+		detail::pyr_down_bands(in, out, tab, (circular_buffer<arma::Col<int> >*)NULL);
+	}
+
+	/**
+	 *	@brief	Blurs a view and downsamples it, see #pyrDown.
+	 *	@param out	the destination image or view, of which size has to be set
+	 *	@note	The transpose of a ::row_major view is a ::col_major one, and the kernel is symmetric.
+	 *			A view is thus downsampled in its own layout, and only the output is transposed
+	 *			when its layout differs from that of the input.
+	 */
+	template <border_type border, typename T1, typename T2>
+	void pyrDown(const image_view<T1>& in, T2& out, T1 value = 0)
+	{
+		typedef typename T2::elem_type out_type;
+		(void)sizeof(detail::static_check<border != transparent>);	// the border is not supported
+
+		if (out.n_elem == 0) return;
+
+		image_view<out_type> dst = detail::as_view(out);
+		const image_view<T1> src = detail::col_major_view(in);
+		image_view<out_type> dst_cm = detail::col_major_view(dst);
+
+		detail::pyr_down_border tab;
+		if (in.layout() == dst.layout()) {
+			tab.create(src.n_rows, src.n_cols, dst_cm.n_rows, dst_cm.n_cols, border, (int)value);
+			detail::pyr_down_bands(src, dst_cm, tab, (circular_buffer<arma::Col<int> >*)NULL);
+		} else {
+			pooled_image<out_type> tmp(dst_cm.n_rows, dst_cm.n_cols);
+			tab.create(src.n_rows, src.n_cols, tmp->n_rows, tmp->n_cols, border, (int)value);
+			detail::pyr_down_bands(src, *tmp, tab, (circular_buffer<arma::Col<int> >*)NULL);
+			detail::transpose_copy(tmp->memptr(), tmp->n_rows, dst_cm.memptr(), dst_cm.stride(), tmp->n_rows, tmp->n_cols);
+		}
+	}
+
+	/// Blurs an image and downsamples it with the ::reflect101 border.
 	template <typename T1, typename T2>
 	void pyrDown(const T1& in, T2& out)
 	{
-		const uword KERNEL_SIZE = 5;
+		pyrDown<reflect101>(in, out);
+	}
 
-		//uword width = std::min((src.n_cols - SZ / 2 - 1) / 2;
-		
-		circular_buffer<arma::ivec> cols(KERNEL_SIZE);
+	namespace detail
+	{
+		/**
+		 *	@brief	Vertical pass of #pyrUp, upsamples a column of @c n_in pixels into @c 2 n_in sums.
+		 *	@param lo	the pixel interpolated above the column
+		 *	@param hi	the pixel interpolated below the column
+		 */
+		template <typename T>
+		inline void pyr_up_vertical(const T* src, int* dst, arma::uword n_in, arma::uword lo, arma::uword hi)
+		{
+			if (n_in == 1) {
+				dst[0] = src[lo] + src[0] * 6 + src[hi];
+				dst[1] = (src[0] + src[hi]) * 4;
+				return;
+			}
 
-#ifdef __VXWORKS__
-		ivec dummy(out.n_rows); dummy.zeros();
+			dst[0] = src[lo] + src[0] * 6 + src[1];
+			dst[1] = (src[0] + src[1]) * 4;
+
+			for (arma::uword y = 1 ; y < n_in - 1 ; y++) {
+				dst[y * 2]     = src[y - 1] + src[y] * 6 + src[y + 1];
+				dst[y * 2 + 1] = (src[y] + src[y + 1]) * 4;
+			}
+
+			dst[n_in * 2 - 2] = src[n_in - 2] + src[n_in - 1] * 6 + src[hi];
+			dst[n_in * 2 - 1] = (src[n_in - 1] + src[hi]) * 4;
+		}
+
+		/**
+		 *	@brief	Upsamples the input columns [x0, x1) into the output columns [2 x0, 2 x1),
+		 *			keeping only three vertically upsampled columns in a #circular_buffer.
+		 *	@param n_rows	the height of the output, either 2 in.n_rows or 2 in.n_rows - 1
+		 *	@param n_cols	the width of the output, either 2 in.n_cols or 2 in.n_cols - 1
+		 *	@param sink		called with each output column index and its values
+		 */
+		template <typename T1, typename Sink>
+		void pyr_up_band(const T1& in, arma::uword n_rows, arma::uword n_cols, arma::uword x0, arma::uword x1, Sink& sink)
+		{
+			const uword KERNEL_SIZE = 3;
+			const uword n = in.n_rows * 2;
+
+			circular_buffer<arma::Col<int> > cols(KERNEL_SIZE);
+			for (arma::uword i = 0 ; i < KERNEL_SIZE ; i++)
+				cols.push_back(zeros<arma::Col<int> >(n));
+
+			arma::Col<int> tmp(n_rows);
+			int* t = tmp.memptr();
+
+			// the same border handling as OpenCV, the image is reflected around its first pixel and replicated after its last one
+			const arma::uword lo = borderInterpolate(-2, (int)n) / 2,
+							  hi = borderInterpolate((int)n, (int)n) / 2;
+
+			int sx = (int)x0 - 1;
+			for (arma::uword x = x0 ; x < x1 ; x++) {
+				// vertical upsampling
+				for ( ; sx <= (int)x + 1 ; sx++) {
+					const typename T1::elem_type* src = in.colptr(borderInterpolate(sx * 2, (int)in.n_cols * 2) / 2);
+					pyr_up_vertical(src, cols.next().memptr(), in.n_rows, lo, hi);
+				}
+
+				const int* col0 = cols[0].memptr();
+				const int* col1 = cols[1].memptr();
+				const int* col2 = cols[2].memptr();
+
+				// horizontal upsampling
+				for (arma::uword y = 0 ; y < n_rows ; y++)
+					t[y] = castOpUp(col0[y] + col1[y] * 6 + col2[y]);
+				sink(x * 2, t);
+
+				if (x * 2 + 1 < n_cols) {
+					for (arma::uword y = 0 ; y < n_rows ; y++)
+						t[y] = castOpUp((col1[y] + col2[y]) * 4);
+					sink(x * 2 + 1, t);
+				}
+			}
+		}
+
+		/// Upsamples the whole image, in parallel bands if enabled.
+		template <typename T1, typename Sink>
+		void pyr_up(const T1& in, arma::uword n_rows, arma::uword n_cols, Sink& sink)
+		{
+			assert(n_rows <= in.n_rows * 2 && n_rows + 1 >= in.n_rows * 2);
+			assert(n_cols <= in.n_cols * 2 && n_cols + 1 >= in.n_cols * 2);
+
+			if (in.n_elem == 0) return;
+
+			const uword n_in = (n_cols + 1) / 2;
+#if defined(USE_PPL) || defined(USE_OPENMP)
+			const uword band = pyramid_band_cols / 2;
+			const uword n_bands = (n_in + band - 1) / band;
+#if defined(USE_PPL)
+			concurrency::parallel_for(uword(0), n_bands, [&](uword b) {
+#else
+	#pragma omp parallel for
+			for (int sb = 0 ; sb < (int)n_bands ; sb++) {
+				uword b = (uword)sb;
 #endif
-		for (arma::uword i = 0 ; i < KERNEL_SIZE ; i++)
-#ifdef __VXWORKS__
-			cols.push_back(dummy);
+				pyr_up_band(in, n_rows, n_cols, b * band, std::min((b + 1) * band, n_in), sink);
+#if defined(USE_PPL)
+			});
 #else
-			cols.push_back(zeros<ivec>(out.n_rows));
+			}
 #endif
+#else
+			pyr_up_band(in, n_rows, n_cols, 0, n_in, sink);
+#endif
+		}
+
+		/// Stores upsampled columns into an image.
+		template <typename T2>
+		struct pyr_up_store
+		{
+			T2& out;
+
+			pyr_up_store(T2& out_) : out(out_) {}
+
+			void operator()(arma::uword x, const int* v)
+			{
+				typename T2::elem_type* dst = out.colptr(x);
+				for (arma::uword y = 0 ; y < out.n_rows ; y++)
+					dst[y] = (typename T2::elem_type)v[y];
+			}
+		};
 
-		int sx0 = -(int)KERNEL_SIZE / 2, sx = sx0;
+		/// Stores the difference between a Gaussian level and the upsampled next level.
+		template <typename T, typename LT>
+		struct pyr_up_subtract
+		{
+			const Image<T>& g;
+			Image<LT>& out;
 
-		arma::umat tab(KERNEL_SIZE + 2, 2);
-		uword* lptr = tab.colptr(0),
-			 * rptr = tab.colptr(1);
-		for (uword y = 0 ; y <= KERNEL_SIZE + 1 ; y++) {
-			lptr[y] = borderInterpolate((int)y + sx0, (int)in.n_rows);
-			rptr[y] = borderInterpolate((int)(y + (out.n_rows - 1) * 2) + sx0, (int)in.n_rows);
+			pyr_up_subtract(const Image<T>& g_, Image<LT>& out_) : g(g_), out(out_) {}
+
+			void operator()(arma::uword x, const int* v)
+			{
+				const T* src = g.colptr(x);
+				LT* dst = out.colptr(x);
+				for (arma::uword y = 0 ; y < out.n_rows ; y++)
+					dst[y] = (LT)src[y] - (LT)v[y];
+			}
+		};
+
+		/// Stores the sum of a Laplacian level and the upsampled next level.
+		template <typename LT>
+		struct pyr_up_add
+		{
+			const Image<LT>& l;
+			Image<LT>& out;
+
+			pyr_up_add(const Image<LT>& l_, Image<LT>& out_) : l(l_), out(out_) {}
+
+			void operator()(arma::uword x, const int* v)
+			{
+				const LT* src = l.colptr(x);
+				LT* dst = out.colptr(x);
+				for (arma::uword y = 0 ; y < out.n_rows ; y++)
+					dst[y] = src[y] + (LT)v[y];
+			}
+		};
+	}
+
+	/**
+	 *	@brief	Upsamples an image and then blurs it.<br>
+	 *			This function performs the upsampling step of the Gaussian pyramid construction.<br>
+	 *			First, it upsamples the source image by injecting even zero rows and columns,
+	 *			then it convolves the result with the kernel of #pyrDown multiplied by 4.
+	 *	@param in	the source image
+	 *	@param out	the destination image, of which size has to be set to twice or twice minus one the source size
+	 *	@note	Only three vertically upsampled columns are kept in memory.
+	 *			Borders are handled as in OpenCV, so the results are identical.
+	 *	@see	pyrUp_ in pyramid.cpp of OpenCV
+	 */
+	template <typename T1, typename T2>
+	void pyrUp(const T1& in, T2& out)
+	{
+		detail::pyr_up_store<T2> sink(out);
+		detail::pyr_up(in, out.n_rows, out.n_cols, sink);
+	}
+
+	/**
+	 *	@brief	Builds a Laplacian pyramid.
+	 *	@param img		the source image
+	 *	@param pyr		the pyramid; pyr[k] is the difference between the k-th Gaussian level and the upsampled (k+1)-th level,
+	 *					and the last level is the coarsest Gaussian level.
+	 *	@param levels	the number of levels, at least one
+	 *	@note	Each difference is computed while upsampling, without the upsampled image in memory.
+	 *			Use a signed type for @c LT.
+	 */
+	template <typename T, typename LT>
+	void buildLaplacianPyramid(const Image<T>& img, std::vector<Image<LT> >& pyr, arma::uword levels)
+	{
+		assert(levels > 0);
+		pyr.resize(levels);
+
+		Image<T> buf[2];
+		const Image<T>* g = &img;
+
+		for (arma::uword k = 0 ; k + 1 < levels ; k++) {
+			Image<T>& next = buf[k % 2];
+			next.resize((g->width() + 1) / 2, (g->height() + 1) / 2);
+			pyrDown(*g, next);
+
+			pyr[k].resize(g->width(), g->height());
+			detail::pyr_up_subtract<T, LT> sink(*g, pyr[k]);
+			detail::pyr_up(next, g->n_rows, g->n_cols, sink);
+
+			g = &next;
 		}
 
-		// gaussian convolution with 
-		for (arma::uword x = 0 ; x < out.n_cols ; x++) {
-			typename T2::elem_type* dst = out.colptr(x);
+		pyr[levels - 1] = Image<LT>(*g);
+	}
 
-			// vertical convolution and decimation
-			for ( ; sx <= (int)x * 2 + 2 ; sx++) {
-				ivec& col = cols.next();
-				int* colptr = col.memptr();
+	/**
+	 *	@brief	Reconstructs an image from its Laplacian pyramid.
+	 *	@param pyr	the pyramid built by #buildLaplacianPyramid
+	 *	@param out	the reconstructed image; it equals the source image unless the pyramid has been modified.
+	 */
+	template <typename LT, typename T>
+	void collapseLaplacianPyramid(const std::vector<Image<LT> >& pyr, Image<T>& out)
+	{
+		assert(!pyr.empty());
 
-				// interpolate border
-				const typename T2::elem_type* src = in.colptr(borderInterpolate(sx, (int)in.n_cols));
+		Image<LT> buf[2];
+		const Image<LT>* g = &pyr.back();
 
-				colptr[0] = src[lptr[2]] * 6 + (src[lptr[1]] + src[lptr[3]]) * 4 + (src[lptr[0]] + src[lptr[4]]);
+		for (arma::uword k = pyr.size() - 1 ; k > 0 ; k--) {
+			Image<LT>& next = buf[k % 2];
+			next.resize(pyr[k - 1].width(), pyr[k - 1].height());
 
-				for (arma::uword y = 1 ; y < out.n_rows - 1; y++)
-				//concurrency::parallel_for(uword(1), out.n_rows - 1, [&](uword y) {
-					colptr[y] = src[y * 2] * 6 + 
-							 (src[y * 2 - 1] + src[y * 2 + 1]) * 4 + 
-							 (src[y * 2 - 2] + src[y * 2 + 2]);
-				//});
+			detail::pyr_up_add<LT> sink(pyr[k - 1], next);
+			detail::pyr_up(*g, next.n_rows, next.n_cols, sink);
+
+			g = &next;
+		}
 
-				colptr[out.n_rows - 1] = src[rptr[2]] * 6 + 
-									  (src[rptr[1]] + src[rptr[3]]) * 4 + 
-									  (src[rptr[0]] + src[rptr[4]]);
+		out = Image<T>(*g);
+	}
+
+	/**
+	 *	@brief	Gaussian pyramid of which levels share a single preallocated arena.<br>
+	 *			The arena, the border tables and the working columns of #pyrDown are allocated once
+	 *			at construction, so building the pyramid of every frame does not touch the heap.
+	 *	@note	Level 0 is the image given to #build, which must stay alive while the levels are used.
+	 *			In the fused mode, the levels are built column by column together,
+	 *			so that the columns of a level are downsampled while still in cache.
+	 *			Otherwise, each level is built in parallel bands as #pyrDown does.
+	 *	@tparam	border	the border type of #pyrDown
+	 */
+	template <typename T, border_type border = reflect101>
+	class gaussian_pyramid
+	{
+		typedef char border_not_supported[(border != transparent) ? 1 : -1];
+
+	public:
+		typedef arma::uword		size_type;
+
+		static const size_type alignment = 64;	///< the alignment of each level in bytes
+
+		/**
+		 *	@brief	Constructor
+		 *	@param width	the width of the images
+		 *	@param height	the height of the images
+		 *	@param levels	the number of levels including the image itself
+		 *	@param fused	whether to build the levels together
+		 *	@param value	the value of the pixels outside of the image for the ::constant border
+		 */
+		gaussian_pyramid(size_type width, size_type height, size_type levels, bool fused = false, T value = 0)
+			: width_(width), height_(height), fused_(fused), base_(NULL)
+		{
+			assert(levels > 0);
+
+			const size_type pad = alignment / sizeof(T);
+			std::vector<size_type> offsets(levels, 0);
+
+			size_type w = width, h = height, total = 0;
+			for (size_type k = 1 ; k < levels ; k++) {
+				w = (w + 1) / 2; h = (h + 1) / 2;
+				offsets[k] = total;
+				total += (w * h + pad - 1) / pad * pad;
 			}
 
-			const int* col0 = cols[0].memptr();
-			const int* col1 = cols[1].memptr();
-			const int* col2 = cols[2].memptr();
-			const int* col3 = cols[3].memptr();
-			const int* col4 = cols[4].memptr();
+			arena_.resize(total + pad);
+			T* ptr = align(&arena_[0]);
 
-			// horizontal convolution and decimation
-#if ENABLE_SSE2
-			//__m128i d = _mm_set1_epi16(128);
-			//uword y = 0;
-			//for ( ; y <= out.n_rows - 16 ; y += 16) {
-			//	__m128i c0, c1, c2, c3, c4, t0, t1;
-			//	c0 = _mm_packs_epi32(_mm_load_si128((const __m128i*)(col0 + y)),
-			//						 _mm_load_si128((const __m128i*)(col0 + y + 4)));
-			//	c1 = _mm_packs_epi32(_mm_load_si128((const __m128i*)(col1 + y)),
-			//						 _mm_load_si128((const __m128i*)(col1 + y + 4)));
-			//	c2 = _mm_packs_epi32(_mm_load_si128((const __m128i*)(col2 + y)),
-			//						 _mm_load_si128((const __m128i*)(col2 + y + 4)));
-			//	c3 = _mm_packs_epi32(_mm_load_si128((const __m128i*)(col3 + y)),
-			//						 _mm_load_si128((const __m128i*)(col3 + y + 4)));
-			//	c4 = _mm_packs_epi32(_mm_load_si128((const __m128i*)(col4 + y)),
-			//						 _mm_load_si128((const __m128i*)(col4 + y + 4)));
-
-			//	c0 = _mm_add_epi16(r0, r4);
-			//	c1 = _mm_add_epi16(_mm_add_epi16(c1, c3), c2);
-			//}
+			levels_.resize(levels, NULL);
+			tabs_.resize(levels);
+			sx_.resize(levels);
+			done_.resize(levels);
+
+			w = width; h = height;
+			for (size_type k = 1 ; k < levels ; k++) {
+				tabs_[k].create(h, w, (h + 1) / 2, (w + 1) / 2, border, (int)value);
+				w = (w + 1) / 2; h = (h + 1) / 2;
+				levels_[k] = new Image<T>(ptr + offsets[k], w, h, false, true);
+			}
+
+			if (levels == 1) return;
+
+			// the working columns of each level when fused, or of each band of the first level
+			const size_type n_rings = fused_ ? levels : (levels_[1]->n_cols + detail::pyramid_band_cols - 1) / detail::pyramid_band_cols;
+			rings_.resize(n_rings, circular_buffer<arma::Col<int> >(5));
+			for (size_type i = 0 ; i < n_rings ; i++)
+				detail::pyr_down_ring(rings_[i], fused_ ? levels_[std::max(i, (size_type)1)]->n_rows : levels_[1]->n_rows);
+		}
+
+		/// Destructor
+		~gaussian_pyramid()
+		{
+			for (size_type k = 1 ; k < levels_.size() ; k++)
+				delete levels_[k];
+		}
+
+		/**
+		 *	@brief	Builds all levels of the pyramid.
+		 *	@param img	the image of the size given at construction
+		 */
+		void build(const Image<T>& img)
+		{
+			assert(img.width() == width_ && img.height() == height_);
+			base_ = &img;
+
+			if (levels_.size() == 1) return;
+
+			if (fused_)
+				build_fused();
+			else {
+				for (size_type k = 1 ; k < levels_.size() ; k++)
+					detail::pyr_down_bands(level(k - 1), *levels_[k], tabs_[k], &rings_[0]);
+			}
+		}
+
+		/// Gets the number of levels
+		inline size_type levels() const { return levels_.size(); }
+
+		/// Gets the k-th level
+		inline const Image<T>& level(size_type k) const
+		{
+			assert(k < levels_.size() && (k > 0 || base_));
+			return k ? *levels_[k] : *base_;
+		}
+
+		/// Gets the k-th level
+		inline const Image<T>& operator[](size_type k) const { return level(k); }
+
+	private:
+		gaussian_pyramid(const gaussian_pyramid&);
+		gaussian_pyramid& operator=(const gaussian_pyramid&);
+
+		static T* align(T* ptr)
+		{
+			return reinterpret_cast<T*>((reinterpret_cast<size_t>(ptr) + alignment - 1) & ~(size_t)(alignment - 1));
+		}
+
+		/// Downsamples the columns of every level as soon as the columns of the level above it are available.
+		void build_fused()
+		{
+			const size_type n = levels_.size();
+
+			done_[0] = base_->n_cols;
+			for (size_type k = 1 ; k < n ; k++) {
+				done_[k] = 0;
+				sx_[k] = -2;
+			}
+
+			for (size_type x = 0 ; x < levels_[1]->n_cols ; x++) {
+				detail::pyr_down_column(*base_, *levels_[1], x, sx_[1], tabs_[1], rings_[1]);
+				done_[1]++;
+
+				for (size_type k = 2 ; k < n ; k++) {
+					const Image<T>& in = *levels_[k - 1];
+					Image<T>& out = *levels_[k];
+					// a column needs the input columns up to 2 x + 2, reflected inside the image
+					while (done_[k] < out.n_cols && done_[k - 1] > std::min(done_[k] * 2 + 2, (size_type)in.n_cols - 1)) {
+						detail::pyr_down_column(in, out, done_[k], sx_[k], tabs_[k], rings_[k]);
+						done_[k]++;
+					}
+				}
+			}
+		}
+
+	private:
+		size_type		width_;				///< the width of level 0
+		size_type		height_;			///< the height of level 0
+		bool			fused_;				///< whether the levels are built together
+		const Image<T>*	base_;				///< level 0
+
+		std::vector<T>	arena_;				///< the memory of all levels
+		std::vector<Image<T>*>	levels_;	///< the levels on the arena, from level 1
+		std::vector<detail::pyr_down_border>	tabs_;	///< the border tables of the levels
+		std::vector<circular_buffer<arma::Col<int> > >	rings_;	///< the working columns
+		std::vector<int>		sx_;		///< the next input column of each level when fused
+		std::vector<size_type>	done_;		///< the number of built columns of each level when fused
+	};
+
+	namespace detail
+	{
+		/// Taps of an anti-aliased resampling along one axis.
+		struct resample_table
+		{
+			arma::uvec	first;		///< the first input pixel of each output pixel
+			arma::uvec	count;		///< the number of input pixels of each output pixel
+			arma::fmat	weights;	///< the normalized weights of each output pixel, one column per output pixel
+
+			/**
+			 *	@brief	Computes the taps of a triangle filter which support is widened by the scale factor,
+			 *			so that downsampling averages all input pixels covered by an output pixel.
+			 *	@note	The taps outside of the input are dropped and the others are normalized.
+			 */
+			void create(arma::uword n_in, arma::uword n_out)
+			{
+				const double scale = (double)n_in / n_out;
+				const double support = std::max(scale, 1.0);
+				const arma::uword n_taps = (arma::uword)std::ceil(support) * 2 + 1;
+
+				first.set_size(n_out);
+				count.set_size(n_out);
+				weights.zeros(n_taps, n_out);
+
+				for (arma::uword i = 0 ; i < n_out ; i++) {
+					const double center = (i + 0.5) * scale - 0.5;
+					const int x0 = std::max((int)std::ceil(center - support), 0);
+					const int x1 = std::min((int)std::floor(center + support), (int)n_in - 1);
+
+					float* w = weights.colptr(i);
+					double sum = 0;
+					for (int x = x0 ; x <= x1 ; x++) {
+						w[x - x0] = (float)std::max(1.0 - std::abs(x - center) / support, 0.0);
+						sum += w[x - x0];
+					}
+					for (int x = x0 ; x <= x1 ; x++)
+						w[x - x0] = (float)(w[x - x0] / sum);
+
+					first[i] = x0;
+					count[i] = x1 - x0 + 1;
+				}
+			}
+		};
+
+		/**
+		 *	@brief	Resamples an image with separable anti-aliased filters.
+		 *	@param tmp	the vertically resampled image of out.n_rows x in.n_cols
+		 */
+		template <typename T1, typename T2>
+		void resample(const T1& in, T2& out, const resample_table& ytab, const resample_table& xtab, arma::fmat& tmp)
+		{
+			// vertical resampling within the columns
+			for (arma::uword x = 0 ; x < in.n_cols ; x++) {
+				const typename T1::elem_type* src = in.colptr(x);
+				float* dst = tmp.colptr(x);
+				for (arma::uword y = 0 ; y < out.n_rows ; y++) {
+					const typename T1::elem_type* s = src + ytab.first[y];
+					const float* w = ytab.weights.colptr(y);
+					float v = 0;
+					for (arma::uword k = 0 ; k < ytab.count[y] ; k++)
+						v += s[k] * w[k];
+					dst[y] = v;
+				}
+			}
+
+			// horizontal resampling as weighted sums of columns
+			for (arma::uword x = 0 ; x < out.n_cols ; x++) {
+				typename T2::elem_type* dst = out.colptr(x);
+				const float* w = xtab.weights.colptr(x);
+				const float* src = tmp.colptr(xtab.first[x]);
+				for (arma::uword y = 0 ; y < out.n_rows ; y++) {
+					float v = 0;
+					for (arma::uword k = 0 ; k < xtab.count[x] ; k++)
+						v += src[k * tmp.n_rows + y] * w[k];
+					dst[y] = arma_ext::saturate_cast<typename T2::elem_type>(v);
+				}
+			}
+		}
+	}
+
+	/**
+	 *	@brief	Scale-space pyramid with an arbitrary scale factor between levels.<br>
+	 *			Level k is the image downscaled by @c factor^k. It is resampled from the octave of #pyrDown
+	 *			nearest above it, so the remaining factor is less than 2 and only small images are resampled.
+	 *	@note	The resampling uses a triangle filter which support is widened by the remaining factor to avoid aliasing.
+	 *			The octaves are built with #gaussian_pyramid, and then the levels are resampled in parallel
+	 *			when @c USE_PPL or @c USE_OPENMP is defined. All buffers are allocated at construction.
+	 *	@tparam	border	the border type of the octaves
+	 */
+	template <typename T, border_type border = reflect101>
+	class scale_space_pyramid
+	{
+	public:
+		typedef arma::uword		size_type;
+
+		/**
+		 *	@brief	Constructor
+		 *	@param width	the width of the images
+		 *	@param height	the height of the images
+		 *	@param factor	the scale factor between two levels, greater than 1
+		 *	@param levels	the number of levels including the image itself
+		 */
+		scale_space_pyramid(size_type width, size_type height, double factor, size_type levels)
+			: factor_(factor), octaves_(width, height, n_octaves(width, height, factor, levels))
+		{
+			assert(factor > 1 && levels > 0);
+
+			levels_.resize(levels);
+			octave_.resize(levels);
+			ytabs_.resize(levels);
+			xtabs_.resize(levels);
+			tmps_.resize(levels);
+
+			double scale = 1;
+			for (size_type k = 0 ; k < levels ; k++, scale *= factor) {
+				const size_type w = std::max((size_type)arma_ext::round<int>(width / scale), (size_type)1);
+				const size_type h = std::max((size_type)arma_ext::round<int>(height / scale), (size_type)1);
+
+				// the octave of which size is the nearest above the level
+				size_type o = 0, ow = width, oh = height;
+				while (o + 1 < octaves_.levels() && (ow + 1) / 2 >= w && (oh + 1) / 2 >= h) {
+					ow = (ow + 1) / 2; oh = (oh + 1) / 2; o++;
+				}
+
+				octave_[k] = o;
+				levels_[k].resize(w, h);
+				ytabs_[k].create(oh, h);
+				xtabs_[k].create(ow, w);
+				tmps_[k].set_size(h, ow);
+			}
+		}
+
+		/**
+		 *	@brief	Builds all levels of the pyramid.
+		 *	@param img	the image of the size given at construction
+		 */
+		void build(const Image<T>& img)
+		{
+			octaves_.build(img);
+
+			const size_type n = levels_.size();
+#if defined(USE_PPL)
+			concurrency::parallel_for(size_type(0), n, [&](size_type k) {
+#elif defined(USE_OPENMP)
+	#pragma omp parallel for schedule(dynamic)
+			for (int sk = 0 ; sk < (int)n ; sk++) {
+				size_type k = (size_type)sk;
+#else
+			for (size_type k = 0 ; k < n ; k++) {
+#endif
+				detail::resample(octaves_[octave_[k]], levels_[k], ytabs_[k], xtabs_[k], tmps_[k]);
+#if defined(USE_PPL)
+			});
 #else
-			for (arma::uword y = 0 ; y < out.n_rows ; y++)
-			//concurrency::parallel_for(uword(0), out.n_rows, [&](uword y) {
-				dst[y] = (typename T2::elem_type)castOp(col2[y] * 6 + (col1[y] + col3[y]) * 4 + col0[y] + col4[y]);
-			//});
+			}
 #endif
 		}
-	}
-}
+
+		/// Gets the number of levels
+		inline size_type levels() const { return levels_.size(); }
+
+		/// Gets the k-th level
+		inline const Image<T>& level(size_type k) const { return levels_[k]; }
+
+		/// Gets the k-th level
+		inline const Image<T>& operator[](size_type k) const { return levels_[k]; }
+
+		/// Gets the scale factor of the k-th level relative to the image
+		inline double scale(size_type k) const { return std::pow(factor_, (double)k); }
+
+	private:
+		/// Counts the octaves needed by the smallest level
+		static size_type n_octaves(size_type width, size_type height, double factor, size_type levels)
+		{
+			const double scale = std::pow(factor, (double)(levels - 1));
+			size_type n = 1;
+			while (std::pow(2.0, (double)n) <= scale && (width > 1 || height > 1)) {
+				width = (width + 1) / 2; height = (height + 1) / 2; n++;
+			}
+			return n;
+		}
+
+	private:
+		double								factor_;	///< the scale factor between two levels
+		gaussian_pyramid<T, border>			octaves_;	///< the octaves
+		std::vector<Image<T> >				levels_;	///< the levels
+		std::vector<size_type>				octave_;	///< the octave of each level
+		std::vector<detail::resample_table>	ytabs_;		///< the vertical taps of each level
+		std::vector<detail::resample_table>	xtabs_;		///< the horizontal taps of each level
+		std::vector<arma::fmat>				tmps_;		///< the vertically resampled image of each level
+	};
+}
\ No newline at end of file
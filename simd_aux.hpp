@@ -0,0 +1,116 @@
+/**
+ *	@file		simd_aux.hpp
+ *	@brief		SIMD support macros and runtime CPU feature detection
+ *	@author		seonho.oh@gmail.com
+ *	@date		2015-03-02
+ *	@version	1.0
+ *
+ *	@section	LICENSE
+ *
+ *		Copyright (c) 2013-2015, Seonho Oh
+ *		All rights reserved. 
+ * 
+ *		Redistribution and use in source and binary forms, with or without  
+ *		modification, are permitted provided that the following conditions are  
+ *		met: 
+ * 
+ *		    * Redistributions of source code must retain the above copyright  
+ *		    notice, this list of conditions and the following disclaimer. 
+ *		    * Redistributions in binary form must reproduce the above copyright  
+ *		    notice, this list of conditions and the following disclaimer in the  
+ *		    documentation and/or other materials provided with the distribution. 
+ *		    * Neither the name of the <ORGANIZATION> nor the names of its  
+ *		    contributors may be used to endorse or promote products derived from  
+ *		    this software without specific prior written permission. 
+ * 
+ *		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS  
+ *		IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED  
+ *		TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A  
+ *		PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  
+ *		OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,  
+ *		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,  
+ *		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR  
+ *		PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF  
+ *		LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING  
+ *		NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS  
+ *		SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+ */
+
+#pragma once
+
+#if ENABLE_AVX2 && !defined(ENABLE_SSE2)
+#define ENABLE_SSE2 1
+#endif
+
+#if ENABLE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if ENABLE_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/// Marks a function that contains AVX2 code; it is called only after #auxiliary::simd_support reports AVX2.
+#if ENABLE_AVX2 && (defined(__GNUC__) || defined(__clang__))
+#define AUX_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define AUX_TARGET_AVX2
+#endif
+
+namespace auxiliary
+{
+	/// SIMD instruction sets which kernels are dispatched to at runtime
+	enum simd_level
+	{
+		simd_none,	///< scalar code only
+		simd_sse2,	///< SSE2
+		simd_avx2	///< AVX2
+	};
+
+	namespace detail
+	{
+		/// Queries the instruction sets supported by both the build and the CPU.
+		inline simd_level detect_simd()
+		{
+			simd_level level = simd_none;
+#if ENABLE_SSE2
+	#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 1);
+			if (info[3] & (1 << 26)) level = simd_sse2;
+		#if ENABLE_AVX2
+			__cpuidex(info, 7, 0);
+			const bool avx2 = (info[1] & (1 << 5)) != 0;
+			__cpuid(info, 1);
+			// the OS has to save the YMM registers as well
+			if (avx2 && (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6) level = simd_avx2;
+		#endif
+	#elif defined(__GNUC__) || defined(__clang__)
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("sse2")) level = simd_sse2;
+		#if ENABLE_AVX2
+			if (__builtin_cpu_supports("avx2")) level = simd_avx2;
+		#endif
+	#else
+			level = simd_sse2;
+	#endif
+#endif
+			return level;
+		}
+	}
+
+	/**
+	 *	@brief	Get the best SIMD instruction set available.
+	 *			Kernels are built only when @c ENABLE_SSE2 or @c ENABLE_AVX2 is defined,
+	 *			and used only when the running CPU supports them.
+	 */
+	inline simd_level simd_support()
+	{
+		static const simd_level level = detail::detect_simd();
+		return level;
+	}
+}